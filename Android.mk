@@ -36,11 +36,31 @@ LOCAL_SHARED_LIBRARIES := \
 LOCAL_SRC_FILES := \
     service.cpp \
     Power.cpp \
+    HintQueue.cpp \
+    HintLock.cpp \
     power-helper.c \
     metadata-parser.c \
+    governor-cache.c \
     utils.c \
-    list.c \
-    hint-data.c
+    hint-data.c \
+    hint-client.c \
+    hint-audit.c \
+    lock-journal.c \
+    boost-engine.c \
+    boost-profile.c \
+    stats-cache.c \
+    stats-parser.c \
+    hint-scheduler.c \
+    power-clock.c \
+    hint-stats.c \
+    perf-resource.c \
+    perf-batch.c \
+    perf-native.c \
+    perf-arbiter.c \
+    perf-mode.c \
+    perf-lock.c \
+    power-trace.c \
+    hint-recorder.c
 
 LOCAL_C_INCLUDES := external/libxml2/include \
                     external/icu/icu4c/source/common
@@ -159,6 +179,18 @@ ifeq ($(TARGET_HAS_NO_WLAN_STATS),true)
 LOCAL_CFLAGS += -DNO_WLAN_STATS
 endif
 
+ifneq ($(TARGET_POWERHAL_BOOST_PROFILE),)
+    LOCAL_CFLAGS += -DBOOST_PROFILE_PATH=\"$(TARGET_POWERHAL_BOOST_PROFILE)\"
+endif
+
+ifeq ($(TARGET_POWERHAL_TRACE),false)
+    LOCAL_CFLAGS += -DNO_POWER_TRACE
+endif
+
+ifeq ($(TARGET_POWERHAL_RECORDER),false)
+    LOCAL_CFLAGS += -DNO_HINT_RECORDER
+endif
+
 ifeq ($(TARGET_ARCH),arm)
 LOCAL_CFLAGS += -DARCH_ARM_32
 endif
@@ -174,4 +206,7 @@ include $(BUILD_EXECUTABLE)
 
 endif
 
+# Host benchmark for the hint dispatch path
+include $(LOCAL_PATH)/bench/Android.mk
+
 endif
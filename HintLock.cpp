@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HintLock.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_1 {
+namespace implementation {
+
+void HintLock::lock(Lane lane) {
+    std::unique_lock<std::mutex> lock(mLock);
+
+    if (lane == Lane::URGENT) {
+        mUrgentWaiters++;
+        mUrgentCond.wait(lock, [this] { return !mHeld; });
+        mUrgentWaiters--;
+    } else {
+        mNormalCond.wait(lock, [this] { return !mHeld && mUrgentWaiters == 0; });
+    }
+    mHeld = true;
+}
+
+void HintLock::unlock() {
+    std::lock_guard<std::mutex> lock(mLock);
+
+    mHeld = false;
+    if (mUrgentWaiters) {
+        mUrgentCond.notify_one();
+    } else {
+        mNormalCond.notify_one();
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_1_HINTLOCK_H
+#define ANDROID_HARDWARE_POWER_V1_1_HINTLOCK_H
+
+#include <condition_variable>
+#include <mutex>
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_1 {
+namespace implementation {
+
+// Mutex with two waiter lanes. Whenever it is released while urgent
+// callers are waiting, one of them gets it next, ahead of every normal
+// caller, so display and launch hints never queue behind ordinary ones
+// on a multi-threaded binder pool.
+class HintLock {
+  public:
+    enum class Lane { NORMAL, URGENT };
+
+    class Guard {
+      public:
+        Guard(HintLock& lock, Lane lane) : mLock(lock) { mLock.lock(lane); }
+        ~Guard() { mLock.unlock(); }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+      private:
+        HintLock& mLock;
+    };
+
+    void lock(Lane lane);
+    void unlock();
+
+  private:
+    std::mutex mLock;
+    std::condition_variable mUrgentCond;
+    std::condition_variable mNormalCond;
+    bool mHeld = false;
+    unsigned int mUrgentWaiters = 0;
+};
+
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_1_HINTLOCK_H
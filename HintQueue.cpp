@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "android.hardware.power@1.1-service-qti"
+
+#include <pthread.h>
+
+#include <log/log.h>
+
+#include "HintQueue.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_1 {
+namespace implementation {
+
+HintQueue::HintQueue(Handler handler)
+    : mHandler(std::move(handler)), mWorker(&HintQueue::workerLoop, this) {
+    pthread_setname_np(mWorker.native_handle(), "power-hint-queue");
+}
+
+HintQueue::~HintQueue() {
+    mStop.store(true);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCond.notify_one();
+    }
+    mWorker.join();
+}
+
+bool HintQueue::isDroppable(PowerHint hint) {
+    return hint == PowerHint::INTERACTION || hint == PowerHint::VSYNC;
+}
+
+void HintQueue::wakeWorker() {
+    // Pairs with the fence in workerLoop() so a push is never missed
+    // between the worker's last emptiness check and its wait.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleeping.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCond.notify_one();
+    }
+}
+
+void HintQueue::wakeProducers() {
+    // Pairs with the fence in enqueue(): either the producer's retry sees
+    // the slot just freed, or we see it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSpaceWaiters.load()) {
+        std::lock_guard<std::mutex> lock(mSpaceLock);
+        mSpaceCond.notify_all();
+    }
+}
+
+void HintQueue::enqueue(PowerHint hint, int32_t data, struct hint_client client) {
+    Entry entry = {hint, data, mNextSeq.fetch_add(1, std::memory_order_relaxed), client};
+
+    if (isDroppable(hint)) {
+        Entry oldest;
+
+        while (!mDroppable.push(entry)) {
+            if (mDroppable.pop(oldest))
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else if (!mCritical.push(entry)) {
+        // The worker is stuck in a slow call; sleep until it pops.
+        std::unique_lock<std::mutex> lock(mSpaceLock);
+
+        mOverflowWaits.fetch_add(1, std::memory_order_relaxed);
+        mSpaceWaiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!mCritical.push(entry)) {
+            wakeWorker();
+            mSpaceCond.wait(lock);
+        }
+        mSpaceWaiters.fetch_sub(1);
+    }
+
+    mEnqueued.fetch_add(1, std::memory_order_relaxed);
+    wakeWorker();
+}
+
+bool HintQueue::popNext(Entry& entry) {
+    if (!mHasCriticalHead && mCritical.pop(mCriticalHead)) {
+        mHasCriticalHead = true;
+        wakeProducers();
+    }
+    if (!mHasDroppableHead)
+        mHasDroppableHead = mDroppable.pop(mDroppableHead);
+
+    if (mHasCriticalHead &&
+            (!mHasDroppableHead || mCriticalHead.seq < mDroppableHead.seq)) {
+        entry = mCriticalHead;
+        mHasCriticalHead = false;
+        return true;
+    }
+    if (mHasDroppableHead) {
+        entry = mDroppableHead;
+        mHasDroppableHead = false;
+        return true;
+    }
+
+    return false;
+}
+
+void HintQueue::workerLoop() {
+    Entry entry;
+
+    while (!mStop.load()) {
+        if (popNext(entry)) {
+            hint_client_enter(entry.client);
+            mHandler(entry.hint, entry.data);
+            hint_client_leave();
+            mExecuted.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mSleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!mCritical.empty() || !mDroppable.empty()) {
+            mSleeping.store(false);
+            continue;
+        }
+        mCond.wait(lock, [this] { return !mSleeping.load() || mStop.load(); });
+    }
+}
+
+HintQueue::Counters HintQueue::getCounters() const {
+    return {
+        mEnqueued.load(std::memory_order_relaxed),
+        mExecuted.load(std::memory_order_relaxed),
+        mDropped.load(std::memory_order_relaxed),
+        mOverflowWaits.load(std::memory_order_relaxed),
+    };
+}
+
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
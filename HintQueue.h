@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_1_HINTQUEUE_H
+#define ANDROID_HARDWARE_POWER_V1_1_HINTQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <android/hardware/power/1.0/types.h>
+
+extern "C" {
+#include "hint-client.h"
+}
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_1 {
+namespace implementation {
+
+using ::android::hardware::power::V1_0::PowerHint;
+
+// Bounded lock-free ring (Vyukov). Safe for any number of producers and
+// consumers; producers also pop when they need to evict the oldest entry.
+template <typename T, size_t N>
+class BoundedRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "size must be a power of two");
+
+  public:
+    BoundedRing() {
+        for (size_t i = 0; i < N; i++)
+            mCells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const T& value) {
+        Cell* cell;
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &mCells[pos & (N - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        Cell* cell;
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &mCells[pos & (N - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            if (diff == 0) {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = cell->value;
+        cell->seq.store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return mEnqueuePos.load(std::memory_order_acquire) ==
+               mDequeuePos.load(std::memory_order_acquire);
+    }
+
+  private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    Cell mCells[N];
+    alignas(64) std::atomic<size_t> mEnqueuePos{0};
+    alignas(64) std::atomic<size_t> mDequeuePos{0};
+};
+
+// Runs oneway power hints on a dedicated worker thread so the binder
+// thread can return immediately.
+//
+// Hints are split into two lanes. Interaction/vsync hints are bursty and
+// only the latest one matters, so when their lane is full the oldest
+// entry is dropped. Every other hint (display, launch, video, modes)
+// changes state and is never dropped: producers block until the worker
+// makes room instead.
+// Entries carry their arrival order, and the worker runs whichever lane's
+// head arrived first, so the split never reorders hints.
+class HintQueue {
+  public:
+    using Handler = std::function<void(PowerHint, int32_t)>;
+
+    struct Counters {
+        uint64_t enqueued;
+        uint64_t executed;
+        uint64_t dropped;
+        uint64_t overflowWaits;
+    };
+
+    explicit HintQueue(Handler handler);
+    ~HintQueue();
+
+    // 'client' is who sent the hint; the worker attributes any lock the
+    // hint takes to it.
+    void enqueue(PowerHint hint, int32_t data, struct hint_client client);
+    Counters getCounters() const;
+
+  private:
+    struct Entry {
+        PowerHint hint;
+        int32_t data;
+        uint64_t seq;
+        struct hint_client client;
+    };
+
+    static constexpr size_t kCriticalSize = 64;
+    static constexpr size_t kDroppableSize = 16;
+
+    static bool isDroppable(PowerHint hint);
+    void wakeWorker();
+    void wakeProducers();
+    bool popNext(Entry& entry);
+    void workerLoop();
+
+    Handler mHandler;
+    BoundedRing<Entry, kCriticalSize> mCritical;
+    BoundedRing<Entry, kDroppableSize> mDroppable;
+    std::atomic<uint64_t> mNextSeq{0};
+
+    // Head of each lane, popped ahead by the worker to compare arrival
+    // order. Only the worker touches these.
+    Entry mCriticalHead;
+    Entry mDroppableHead;
+    bool mHasCriticalHead = false;
+    bool mHasDroppableHead = false;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::atomic<bool> mSleeping{false};
+    std::atomic<bool> mStop{false};
+
+    // Producers waiting for room in the critical lane.
+    std::mutex mSpaceLock;
+    std::condition_variable mSpaceCond;
+    std::atomic<unsigned> mSpaceWaiters{0};
+
+    std::atomic<uint64_t> mEnqueued{0};
+    std::atomic<uint64_t> mExecuted{0};
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<uint64_t> mOverflowWaits{0};
+
+    std::thread mWorker;
+};
+
+}  // namespace implementation
+}  // namespace V1_1
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_1_HINTQUEUE_H
@@ -19,11 +19,25 @@
 
 // #define LOG_NDEBUG 0
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <hwbinder/IPCThreadState.h>
 #include <log/log.h>
 #include "Power.h"
+#include "hint-stats.h"
 #include "power-common.h"
 #include "power-helper.h"
 
+extern "C" {
+#include "hint-audit.h"
+#include "hint-client.h"
+#include "hint-data.h"
+#include "perf-arbiter.h"
+#include "utils.h"
+}
+
 /* RPM runs at 19.2Mhz. Divide by 19200 for msec */
 #define RPM_CLK 19200
 
@@ -40,31 +54,87 @@ using ::android::hardware::power::V1_0::PowerHint;
 using ::android::hardware::power::V1_0::PowerStatePlatformSleepState;
 using ::android::hardware::power::V1_0::Status;
 using ::android::hardware::power::V1_1::PowerStateSubsystem;
+using ::android::hardware::hidl_handle;
+using ::android::hardware::hidl_string;
 using ::android::hardware::hidl_vec;
+using ::android::hardware::IPCThreadState;
 using ::android::hardware::Return;
 using ::android::hardware::Void;
 
-Power::Power() {
+namespace {
+
+// Times one entry point, including any wait for mHintLock, into its
+// hint-stats histogram.
+class ScopedHintStats {
+  public:
+    explicit ScopedHintStats(hint_stats_id id) : mId(id), mStart(hint_stats_begin()) {}
+    ~ScopedHintStats() { hint_stats_end(mId, mStart); }
+
+  private:
+    hint_stats_id mId;
+    uint64_t mStart;
+};
+
+// The binder caller of the current call. Only valid on a binder thread.
+struct hint_client callingClient() {
+    IPCThreadState* ipc = IPCThreadState::self();
+    return {ipc->getCallingPid(), static_cast<int>(ipc->getCallingUid())};
+}
+
+// Attributes any long-lived lock taken while in scope to the binder
+// caller, so it can be released if that process dies. Queued hints are
+// attributed by the HintQueue worker instead, from the client recorded
+// when they were enqueued.
+class ScopedHintClient {
+  public:
+    ScopedHintClient() { hint_client_enter(callingClient()); }
+    ~ScopedHintClient() { hint_client_leave(); }
+};
+
+}  // namespace
+
+// Hints that change what the user sees right away skip ahead of every
+// other caller waiting for mHintLock.
+static HintLock::Lane hintLane(PowerHint hint) {
+    return hint == PowerHint::LAUNCH ? HintLock::Lane::URGENT : HintLock::Lane::NORMAL;
+}
+
+Power::Power()
+    : mHintQueue([this](PowerHint hint, int32_t data) { handleHint(hint, data); }) {
     power_init();
 }
 
 // Methods from ::android::hardware::power::V1_0::IPower follow.
 Return<void> Power::setInteractive(bool interactive)  {
+    ScopedHintStats timing(HINT_STATS_SET_INTERACTIVE);
+    HintLock::Guard lock(mHintLock, HintLock::Lane::URGENT);
+    ScopedHintClient client;
     power_set_interactive(interactive ? 1 : 0);
     return Void();
 }
 
-Return<void> Power::powerHint(PowerHint hint, int32_t data) {
+void Power::handleHint(PowerHint hint, int32_t data) {
+    HintLock::Guard lock(mHintLock, hintLane(hint));
     power_hint(static_cast<power_hint_t>(hint), &data);
+}
+
+Return<void> Power::powerHint(PowerHint hint, int32_t data) {
+    ScopedHintStats timing(hint_stats_power_hint_id(static_cast<int>(hint)));
+    ScopedHintClient client;
+    handleHint(hint, data);
     return Void();
 }
 
 Return<void> Power::setFeature(Feature feature, bool activate)  {
+    ScopedHintStats timing(HINT_STATS_SET_FEATURE);
+    HintLock::Guard lock(mHintLock, HintLock::Lane::NORMAL);
+    ScopedHintClient client;
     set_feature(static_cast<feature_t>(feature), activate ? 1 : 0);
     return Void();
 }
 
 Return<void> Power::getPlatformLowPowerStats(getPlatformLowPowerStats_cb _hidl_cb) {
+    ScopedHintStats timing(HINT_STATS_PLATFORM_STATS);
     hidl_vec<PowerStatePlatformSleepState> states;
 #ifdef NO_STATS
     states.resize(0);
@@ -78,11 +148,13 @@ Return<void> Power::getPlatformLowPowerStats(getPlatformLowPowerStats_cb _hidl_c
     struct PowerStatePlatformSleepState *state;
     int ret;
 
-    ret = extract_platform_stats(stats);
+    ret = extract_platform_stats_cached(stats, false);
     if (ret != 0) {
+        hint_stats_note(HINT_OUTCOME_ERROR);
         states.resize(0);
         goto done;
     }
+    hint_stats_note(HINT_OUTCOME_HANDLED);
 
 #ifdef LEGACY_STATS
     states.resize(RPM_MODE_MAX);
@@ -175,7 +247,7 @@ static int get_wlan_low_power_stats(struct PowerStateSubsystem &subsystem) {
     struct PowerStateSubsystemSleepState *state;
     int ret;
 
-    ret = extract_wlan_stats(stats);
+    ret = extract_wlan_stats_cached(stats, false);
     if (ret)
         return ret;
 
@@ -203,6 +275,7 @@ static int get_wlan_low_power_stats(struct PowerStateSubsystem &subsystem) {
 #endif
 
 Return<void> Power::getSubsystemLowPowerStats(getSubsystemLowPowerStats_cb _hidl_cb) {
+    ScopedHintStats timing(HINT_STATS_SUBSYSTEM_STATS);
     hidl_vec<PowerStateSubsystem> subsystems;
 #ifdef NO_WLAN_STATS
     subsystems.resize(0);
@@ -215,8 +288,11 @@ Return<void> Power::getSubsystemLowPowerStats(getSubsystemLowPowerStats_cb _hidl
 
     //We currently have only one Subsystem for WLAN
     ret = get_wlan_low_power_stats(subsystems[subsystem_type::SUBSYSTEM_WLAN]);
-    if (ret != 0)
+    if (ret != 0) {
+        hint_stats_note(HINT_OUTCOME_ERROR);
         goto done;
+    }
+    hint_stats_note(HINT_OUTCOME_HANDLED);
 
     //Add query for other subsystems here
 
@@ -227,8 +303,42 @@ done:
 }
 
 Return<void> Power::powerHintAsync(PowerHint hint, int32_t data) {
-    // just call the normal power hint in this oneway function
-    return powerHint(hint, data);
+    // oneway: hand the hint to the worker and return to the caller
+    mHintQueue.enqueue(hint, data, callingClient());
+    return Void();
+}
+
+// Methods from ::android::hidl::base::V1_0::IBase follow.
+
+Return<void> Power::debug(const hidl_handle& handle, const hidl_vec<hidl_string>& /* args */) {
+    if (handle == nullptr || handle->numFds < 1) {
+        return Void();
+    }
+
+    int fd = handle->data[0];
+
+    hint_stats_dump(fd);
+
+    HintQueue::Counters counters = mHintQueue.getCounters();
+    dprintf(fd, "\nAsync hint queue: enqueued=%" PRIu64 " executed=%" PRIu64
+            " dropped=%" PRIu64 " overflowWaits=%" PRIu64 "\n",
+            counters.enqueued, counters.executed, counters.dropped,
+            counters.overflowWaits);
+
+    struct hint_data hints[HINT_TABLE_SIZE];
+    unsigned int count = get_active_hints(hints, HINT_TABLE_SIZE);
+    dprintf(fd, "\n%u active hint(s)\n", count);
+    for (unsigned int i = 0; i < count; i++) {
+        dprintf(fd, "  hint_id: 0x%lx handle: %lu\n", hints[i].hint_id,
+                hints[i].perflock_handle);
+    }
+
+    hint_audit_dump(fd);
+    hint_client_dump(fd);
+    perf_arbiter_dump(fd);
+
+    fsync(fd);
+    return Void();
 }
 
 status_t Power::registerAsSystemService() {
@@ -23,6 +23,9 @@
 #include <hidl/Status.h>
 #include <hardware/power.h>
 
+#include "HintLock.h"
+#include "HintQueue.h"
+
 namespace android {
 namespace hardware {
 namespace power {
@@ -32,6 +35,9 @@ namespace implementation {
 using ::android::hardware::power::V1_0::Feature;
 using ::android::hardware::power::V1_0::PowerHint;
 using ::android::hardware::power::V1_1::IPower;
+using ::android::hardware::hidl_handle;
+using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_vec;
 using ::android::hardware::Return;
 using ::android::hardware::Void;
 
@@ -50,7 +56,20 @@ struct Power : public IPower {
     Return<void> powerHintAsync(PowerHint hint, int32_t data) override;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) override;
+
+  private:
+    // Runs one hint under mHintLock. Shared by powerHint() and the
+    // async worker, which must not go back through the HIDL entry point.
+    void handleHint(PowerHint hint, int32_t data);
 
+    // Serializes calls into the C hint handlers, which keep their state
+    // (current_mode, display state, video hint flags, ...) in unprotected
+    // statics. Every entry point that reaches them must hold it, whatever
+    // the binder pool size; the low power stats calls do not touch them
+    // and never take it.
+    HintLock mHintLock;
+    HintQueue mHintQueue;
 };
 
 }  // namespace implementation
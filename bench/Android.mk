@@ -0,0 +1,112 @@
+# Copyright (C) 2018 The LineageOS Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH := $(call my-dir)
+
+# Backend linked into the benchmark, e.g. POWER_BENCH_TARGET := 845
+POWER_BENCH_TARGET ?= 8998
+
+# Stand-in for the proprietary perf HAL client library
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libqti-perfd-client-stub
+LOCAL_MODULE_STEM := libqti-perfd-client
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := perfd-client-stub.c
+LOCAL_LDLIBS := -lpthread
+LOCAL_CFLAGS += -Wall -Wextra -Werror
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# The real dispatch path, shared by the benchmark and the replayer
+POWER_BENCH_HAL_SRC_FILES := \
+    ../power-helper.c \
+    ../metadata-parser.c \
+    ../governor-cache.c \
+    ../utils.c \
+    ../hint-data.c \
+    ../hint-client.c \
+    ../hint-audit.c \
+    ../lock-journal.c \
+    ../boost-engine.c \
+    ../boost-profile.c \
+    ../stats-cache.c \
+    ../stats-parser.c \
+    ../hint-scheduler.c \
+    ../power-clock.c \
+    ../hint-stats.c \
+    ../perf-resource.c \
+    ../perf-batch.c \
+    ../perf-native.c \
+    ../perf-arbiter.c \
+    ../perf-mode.c \
+    ../perf-lock.c \
+    ../power-trace.c \
+    ../hint-recorder.c \
+    ../power-$(POWER_BENCH_TARGET).c
+
+POWER_BENCH_CFLAGS := -Wall -Wextra -Werror
+POWER_BENCH_CFLAGS += -DRPM_SYSTEM_STAT=\"/tmp/power-hint-bench/system_stats\"
+POWER_BENCH_CFLAGS += -DNO_WLAN_STATS
+POWER_BENCH_CFLAGS += -DBOOST_PROFILE_PATH=\"/tmp/power-hint-bench/boost_profiles.xml\"
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := power-hint-bench
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := power-hint-bench.c $(POWER_BENCH_HAL_SRC_FILES)
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+LOCAL_SHARED_LIBRARIES := liblog libcutils libxml2
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_REQUIRED_MODULES := libqti-perfd-client-stub
+LOCAL_LDLIBS := -ldl -lpthread
+LOCAL_CFLAGS += $(POWER_BENCH_CFLAGS)
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Feeds a log written by the HAL's hint recorder through the same code
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := power-replay
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := power-replay.c $(POWER_BENCH_HAL_SRC_FILES)
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+LOCAL_SHARED_LIBRARIES := liblog libcutils libxml2
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_REQUIRED_MODULES := libqti-perfd-client-stub
+LOCAL_LDLIBS := -ldl -lpthread
+LOCAL_CFLAGS += $(POWER_BENCH_CFLAGS)
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host tests for code that doesn't need a device
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := power-hal-test
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := power-hal-test.c $(POWER_BENCH_HAL_SRC_FILES)
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+LOCAL_SHARED_LIBRARIES := liblog libcutils libxml2
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_REQUIRED_MODULES := libqti-perfd-client-stub
+LOCAL_LDLIBS := -ldl -lpthread
+LOCAL_CFLAGS += $(POWER_BENCH_CFLAGS)
+
+include $(BUILD_HOST_EXECUTABLE)
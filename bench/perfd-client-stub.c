@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stand-in for the proprietary libqti-perfd-client.so, used by the host
+ * benchmark. It exports the same entry points the HAL resolves through
+ * dlsym() in utils.c and hands out monotonically increasing handles.
+ *
+ * Set POWER_BENCH_PERFD_DELAY_US to emulate the cost of the perfd IPC.
+ * Every call is also logged for the host tests, see perfd-client-stub.h.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "perfd-client-stub.h"
+
+static atomic_int next_handle = 1;
+static atomic_ulong acq_calls;
+static atomic_ulong rel_calls;
+static atomic_ulong hint_calls;
+static atomic_int failing_calls;
+static long delay_ns = -1;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct perf_stub_call calls[PERF_STUB_MAX_CALLS];
+static int num_calls;
+
+static int log_call(enum perf_stub_op op, unsigned long handle, int hint_id,
+        int duration, int list[], int num_args, int ret)
+{
+    struct perf_stub_call *call;
+
+    pthread_mutex_lock(&log_lock);
+    if (num_calls < PERF_STUB_MAX_CALLS) {
+        call = &calls[num_calls++];
+        call->op = op;
+        call->handle = handle;
+        call->hint_id = hint_id;
+        call->duration = duration;
+        call->num_args = num_args > 0 && num_args <= PERF_STUB_MAX_ARGS ? num_args : 0;
+        if (call->num_args)
+            memcpy(call->list, list, call->num_args * sizeof(int));
+        call->ret = ret;
+    }
+    pthread_mutex_unlock(&log_lock);
+
+    return ret;
+}
+
+static void simulate_ipc(void)
+{
+    struct timespec start, now;
+
+    if (delay_ns < 0) {
+        const char *env = getenv("POWER_BENCH_PERFD_DELAY_US");
+        delay_ns = env ? atol(env) * 1000L : 0;
+    }
+
+    if (delay_ns == 0)
+        return;
+
+    /* Busy-wait: a sleep would hide the cost from the caller's clock. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L +
+            (now.tv_nsec - start.tv_nsec) < delay_ns);
+}
+
+static int should_fail(void)
+{
+    int left = atomic_load(&failing_calls);
+
+    while (left > 0) {
+        if (atomic_compare_exchange_weak(&failing_calls, &left, left - 1))
+            return 1;
+    }
+
+    return 0;
+}
+
+int perf_lock_acq(unsigned long handle, int duration, int list[], int numArgs)
+{
+    int ret;
+
+    atomic_fetch_add(&acq_calls, 1);
+    simulate_ipc();
+
+    if (numArgs <= 0 || should_fail())
+        ret = -1;
+    else if (handle > 0)
+        ret = handle;
+    else
+        ret = atomic_fetch_add(&next_handle, 1);
+    return log_call(PERF_STUB_ACQ, handle, 0, duration, list, numArgs, ret);
+}
+
+int perf_lock_rel(unsigned long handle)
+{
+    atomic_fetch_add(&rel_calls, 1);
+    simulate_ipc();
+
+    return log_call(PERF_STUB_REL, handle, 0, 0, NULL, 0, handle > 0 ? 0 : -1);
+}
+
+int perf_hint(int hint_id, char *pkg, int duration, int type)
+{
+    (void)pkg;
+    (void)type;
+
+    atomic_fetch_add(&hint_calls, 1);
+    simulate_ipc();
+
+    return log_call(PERF_STUB_HINT, 0, hint_id, duration, NULL, 0,
+            should_fail() ? -1 : atomic_fetch_add(&next_handle, 1));
+}
+
+void perf_stub_get_counters(unsigned long *acq, unsigned long *rel,
+        unsigned long *hint)
+{
+    *acq = atomic_load(&acq_calls);
+    *rel = atomic_load(&rel_calls);
+    *hint = atomic_load(&hint_calls);
+}
+
+int perf_stub_take_calls(struct perf_stub_call out[], int max)
+{
+    int num;
+
+    pthread_mutex_lock(&log_lock);
+    num = num_calls < max ? num_calls : max;
+    memcpy(out, calls, num * sizeof(calls[0]));
+    num_calls = 0;
+    pthread_mutex_unlock(&log_lock);
+
+    return num;
+}
+
+void perf_stub_fail_next(int calls)
+{
+    atomic_store(&failing_calls, calls);
+}
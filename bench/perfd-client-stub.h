@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERFD_CLIENT_STUB_H
+#define _QCOM_POWER_PERFD_CLIENT_STUB_H
+
+/*
+ * What the stand-in libqti-perfd-client.so records for the host tests.
+ * The tests resolve perf_stub_take_calls() through dlsym().
+ */
+
+#define PERF_STUB_MAX_CALLS 32
+#define PERF_STUB_MAX_ARGS 128
+
+enum perf_stub_op {
+    PERF_STUB_ACQ,
+    PERF_STUB_REL,
+    PERF_STUB_HINT,
+};
+
+struct perf_stub_call {
+    enum perf_stub_op op;
+    unsigned long handle;       /* as passed in */
+    int hint_id;
+    int duration;
+    int num_args;
+    int list[PERF_STUB_MAX_ARGS];
+    int ret;
+};
+
+/*
+ * Copies up to 'max' calls made since the previous take, oldest first,
+ * and forgets them. Calls beyond PERF_STUB_MAX_CALLS are dropped.
+ */
+typedef int (*perf_stub_take_calls_fn)(struct perf_stub_call calls[], int max);
+
+/* Makes the next 'calls' perf_lock_acq() or perf_hint() calls fail. */
+typedef void (*perf_stub_fail_next_fn)(int calls);
+
+#endif
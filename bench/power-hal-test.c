@@ -0,0 +1,1067 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host tests for HAL code that can be checked without a device.
+ * Exits non-zero if any case fails.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "boost-engine.h"
+#include "hint-client.h"
+#include "hint-data.h"
+#include "hint-scheduler.h"
+#include "lock-journal.h"
+#include "metadata-defs.h"
+#include "perf-arbiter.h"
+#include "perf-batch.h"
+#include "perf-mode.h"
+#include "perf-native.h"
+#include "performance.h"
+#include "power-clock.h"
+#include "power-common.h"
+#include "power-trace.h"
+#include "utils.h"
+
+#include "perfd-client-stub.h"
+
+#define NSINUS 1000LL
+#define NSINMS 1000000LL
+
+#define CPU0_MIN_FREQ "/sys/devices/system/cpu/cpu0/cpufreq/scaling_min_freq"
+#define CPU4_MIN_FREQ "/sys/devices/system/cpu/cpu4/cpufreq/scaling_min_freq"
+#define CPU4_MAX_FREQ "/sys/devices/system/cpu/cpu4/cpufreq/scaling_max_freq"
+#define SCHED_BOOST "/proc/sys/kernel/sched_boost"
+
+static int failures;
+
+#define EXPECT_EQ(expected, actual)                                         \
+    do {                                                                    \
+        long long e_ = (expected), a_ = (actual);                           \
+        if (e_ != a_) {                                                     \
+            fprintf(stderr, "%s:%d: expected %s == %lld, got %lld\n",       \
+                    __FILE__, __LINE__, #actual, e_, a_);                   \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static void test_metadata_whitespace(void)
+{
+    struct video_encode_metadata_t encode;
+    struct video_decode_metadata_t decode;
+    char trailing_newline[] = "hint_id=2560;state=1\n";
+    char padded[] = "hint_id= 2816 ;state=0 ";
+    char junk[] = "hint_id=2560;state=1x";
+
+    encode.hint_id = encode.state = -1;
+    EXPECT_EQ(0, parse_video_encode_metadata(trailing_newline, &encode));
+    EXPECT_EQ(0x0A00, encode.hint_id);
+    EXPECT_EQ(1, encode.state);
+
+    decode.hint_id = decode.state = -1;
+    EXPECT_EQ(0, parse_video_decode_metadata(padded, &decode));
+    EXPECT_EQ(0x0B00, decode.hint_id);
+    EXPECT_EQ(0, decode.state);
+
+    /* Anything else after the digits is still rejected. */
+    encode.hint_id = encode.state = -1;
+    EXPECT_EQ(0, parse_video_encode_metadata(junk, &encode));
+    EXPECT_EQ(0x0A00, encode.hint_id);
+    EXPECT_EQ(-1, encode.state);
+}
+
+/*
+ * A sysfs attribute holds exactly what was last written to it. The HAL
+ * writes through cached descriptors at offset 0, so make the regular
+ * files of the fake tree behave the same by cutting off what's left of
+ * a longer previous value.
+ */
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    ssize_t ret = syscall(SYS_pwrite64, fd, buf, count, offset);
+
+    if (ret >= 0 && ftruncate(fd, offset + ret))
+        return -1;
+    return ret;
+}
+
+static char native_root[] = "/tmp/power-hal-test.XXXXXX";
+
+static int write_node(const char *node, const char *value)
+{
+    char path[PATH_MAX];
+    char *slash;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s%s", native_root, node);
+    for (slash = strchr(path + strlen(native_root) + 1, '/'); slash;
+            slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(path, 0755) && errno != EEXIST)
+            return -errno;
+        *slash = '/';
+    }
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -errno;
+    fprintf(fp, "%s\n", value);
+    fclose(fp);
+
+    return 0;
+}
+
+static long long read_node(const char *node)
+{
+    char path[PATH_MAX];
+    long long value = -1;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s%s", native_root, node);
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    if (fscanf(fp, "%lld", &value) != 1)
+        value = -1;
+    fclose(fp);
+
+    return value;
+}
+
+/* Two clusters of four: cpu0-3 up to 1.9 GHz, cpu4-7 up to 2.4 GHz. */
+static int make_native_tree(void)
+{
+    char node[128];
+    int cpu, ret = 0;
+
+    if (!mkdtemp(native_root))
+        return -errno;
+
+    for (cpu = 0; cpu < 8 && !ret; cpu++) {
+        snprintf(node, sizeof(node),
+                "/sys/devices/system/cpu/cpu%d/cpufreq/related_cpus", cpu);
+        ret |= write_node(node, cpu < 4 ? "0 1 2 3" : "4 5 6 7");
+        snprintf(node, sizeof(node),
+                "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        ret |= write_node(node, cpu < 4 ? "1900000" : "2400000");
+        snprintf(node, sizeof(node),
+                "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_min_freq", cpu);
+        ret |= write_node(node, "300000");
+        snprintf(node, sizeof(node),
+                "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_max_freq", cpu);
+        ret |= write_node(node, cpu < 4 ? "1900000" : "2400000");
+    }
+    ret |= write_node(SCHED_BOOST, "0");
+
+    return ret;
+}
+
+static int remove_node(const char *path, const struct stat *st, int flag,
+        struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+
+    return remove(path);
+}
+
+static void remove_native_tree(void)
+{
+    nftw(native_root, remove_node, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void test_native_root_too_long(void)
+{
+    char root[256];
+    int list[] = { SCHED_BOOST_ON_V3, 1 };
+
+    memset(root, 'x', sizeof(root) - 1);
+    root[sizeof(root) - 1] = '\0';
+
+    EXPECT_EQ(-ENAMETOOLONG, perf_native_init(root));
+    EXPECT_EQ(-1, perf_native_acquire(0, 0, list, ARRAY_SIZE(list)));
+    EXPECT_EQ(0, perf_native_init(native_root));
+}
+
+static void test_native_writes(void)
+{
+    int list[] = {
+        MIN_FREQ_BIG_CORE_0, 1200,
+        MIN_FREQ_LITTLE_CORE_0, 0xFFF,      /* cpuinfo_max_freq */
+        SCHED_BOOST_ON_V3, 1,
+    };
+    int handle;
+
+    handle = perf_native_acquire(0, 0, list, ARRAY_SIZE(list));
+    EXPECT_EQ(1, handle > 0);
+    EXPECT_EQ(1200000, read_node(CPU4_MIN_FREQ));
+    EXPECT_EQ(1900000, read_node(CPU0_MIN_FREQ));
+    EXPECT_EQ(1, read_node(SCHED_BOOST));
+
+    EXPECT_EQ(0, perf_native_release(handle));
+}
+
+static void test_native_overlap(void)
+{
+    int a[] = { MIN_FREQ_BIG_CORE_0, 1200, MAX_FREQ_BIG_CORE_0, 2000 };
+    int b[] = { MIN_FREQ_BIG_CORE_0, 1500, MAX_FREQ_BIG_CORE_0, 1800 };
+    int c[] = { MIN_FREQ_BIG_CORE_0, 1000 };
+    int ha, hb, hc;
+
+    /* Highest floor and lowest cap win. */
+    ha = perf_native_acquire(0, 0, a, ARRAY_SIZE(a));
+    hb = perf_native_acquire(0, 0, b, ARRAY_SIZE(b));
+    hc = perf_native_acquire(0, 0, c, ARRAY_SIZE(c));
+    EXPECT_EQ(1500000, read_node(CPU4_MIN_FREQ));
+    EXPECT_EQ(1800000, read_node(CPU4_MAX_FREQ));
+
+    /* Dropping the winner falls back to what the others ask for. */
+    perf_native_release(hb);
+    EXPECT_EQ(1200000, read_node(CPU4_MIN_FREQ));
+    EXPECT_EQ(2000000, read_node(CPU4_MAX_FREQ));
+
+    perf_native_release(ha);
+    EXPECT_EQ(1000000, read_node(CPU4_MIN_FREQ));
+    EXPECT_EQ(2400000, read_node(CPU4_MAX_FREQ));
+
+    perf_native_release(hc);
+}
+
+static void test_native_restore(void)
+{
+    int a[] = { MIN_FREQ_BIG_CORE_0, 1200, SCHED_BOOST_ON_V3, 1 };
+    int b[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+    int ha, hb;
+
+    ha = perf_native_acquire(0, 0, a, ARRAY_SIZE(a));
+    hb = perf_native_acquire(0, 0, b, ARRAY_SIZE(b));
+
+    perf_native_release(ha);
+    EXPECT_EQ(1500000, read_node(CPU4_MIN_FREQ));
+    EXPECT_EQ(0, read_node(SCHED_BOOST));
+
+    /* The original value comes back only with the last user gone. */
+    perf_native_release(hb);
+    EXPECT_EQ(300000, read_node(CPU4_MIN_FREQ));
+
+    EXPECT_EQ(-1, perf_native_release(hb));
+}
+
+static void test_native_expiry(void)
+{
+    int list[] = { MIN_FREQ_BIG_CORE_0, 1200 };
+    int handle;
+
+    handle = perf_native_acquire(0, 100, list, ARRAY_SIZE(list));
+    power_clock_advance(99 * NSINMS);
+    EXPECT_EQ(1200000, read_node(CPU4_MIN_FREQ));
+
+    /* A renewal moves the deadline. */
+    EXPECT_EQ(handle, perf_native_acquire(handle, 100, list, ARRAY_SIZE(list)));
+    power_clock_advance(50 * NSINMS);
+    EXPECT_EQ(1200000, read_node(CPU4_MIN_FREQ));
+
+    power_clock_advance(51 * NSINMS);
+    EXPECT_EQ(300000, read_node(CPU4_MIN_FREQ));
+    EXPECT_EQ(-1, perf_native_release(handle));
+}
+
+/* Stands in for perfd behind the arbiter and records what reaches it. */
+static struct {
+    int acquired;
+    int released;
+    int next_handle;
+    int handle;
+    int duration;
+    int num_args;
+    int list[PERF_ARBITER_MAX_OPCODES * 2];
+} downstream;
+
+static int downstream_acquire(int handle, int duration, int list[], int num_args)
+{
+    downstream.acquired++;
+    downstream.duration = duration;
+    downstream.num_args = num_args;
+    memcpy(downstream.list, list, num_args * sizeof(int));
+    downstream.handle = handle ? handle : ++downstream.next_handle;
+
+    return downstream.handle;
+}
+
+static int downstream_release(int handle)
+{
+    (void)handle;
+
+    downstream.released++;
+    return 0;
+}
+
+static void reset_downstream(void)
+{
+    static const struct perf_arbiter_ops ops = {
+        .acquire = downstream_acquire,
+        .release = downstream_release,
+    };
+
+    perf_arbiter_init(&ops);
+    downstream.acquired = downstream.released = 0;
+}
+
+static void test_arbiter_one_lock_per_change(void)
+{
+    int a[] = { MIN_FREQ_BIG_CORE_0, 1200, MIN_FREQ_LITTLE_CORE_0, 1000,
+            SCHED_BOOST_ON_V3, 1 };
+    int b[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+    int ha, hb;
+
+    reset_downstream();
+
+    ha = perf_arbiter_acquire(0, 0, a, ARRAY_SIZE(a));
+    EXPECT_EQ(1, downstream.acquired);
+    EXPECT_EQ(6, downstream.num_args);
+    EXPECT_EQ(0, downstream.duration);
+
+    /* The replacement carries the unchanged values of the old lock. */
+    hb = perf_arbiter_acquire(0, 0, b, ARRAY_SIZE(b));
+    EXPECT_EQ(2, downstream.acquired);
+    EXPECT_EQ(6, downstream.num_args);
+    EXPECT_EQ(1, downstream.released);
+
+    perf_arbiter_release(ha);
+    EXPECT_EQ(3, downstream.acquired);
+    EXPECT_EQ(2, downstream.num_args);
+    EXPECT_EQ(2, downstream.released);
+
+    perf_arbiter_release(hb);
+    EXPECT_EQ(3, downstream.acquired);
+    EXPECT_EQ(3, downstream.released);
+}
+
+static void test_arbiter_timed(void)
+{
+    int a[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+    int b[] = { MIN_FREQ_BIG_CORE_0, 1200 };
+    int ha, hb, lock;
+
+    reset_downstream();
+
+    /* Downstream times the lock out too, with some slack. */
+    ha = perf_arbiter_acquire(0, 100, a, ARRAY_SIZE(a));
+    EXPECT_EQ(1, downstream.acquired);
+    EXPECT_EQ(200, downstream.duration);
+    lock = downstream.handle;
+
+    /* A losing request changes nothing. */
+    hb = perf_arbiter_acquire(0, 0, b, ARRAY_SIZE(b));
+    EXPECT_EQ(1, downstream.acquired);
+
+    /* A renewal the lock already outlasts costs nothing... */
+    power_clock_advance(60 * NSINMS);
+    EXPECT_EQ(ha, perf_arbiter_acquire(ha, 100, a, ARRAY_SIZE(a)));
+    EXPECT_EQ(1, downstream.acquired);
+
+    /* ...and one past its end only moves the end of the same lock. */
+    power_clock_advance(90 * NSINMS);
+    EXPECT_EQ(ha, perf_arbiter_acquire(ha, 100, a, ARRAY_SIZE(a)));
+    EXPECT_EQ(2, downstream.acquired);
+    EXPECT_EQ(lock, downstream.handle);
+    EXPECT_EQ(200, downstream.duration);
+    EXPECT_EQ(0, downstream.released);
+
+    /* Once the winner runs out, the loser's value is held for good. */
+    power_clock_advance(100 * NSINMS);
+    EXPECT_EQ(3, downstream.acquired);
+    EXPECT_EQ(0, downstream.duration);
+    EXPECT_EQ(1, downstream.released);
+
+    perf_arbiter_release(hb);
+    EXPECT_EQ(2, downstream.released);
+}
+
+static void noop(void *arg)
+{
+    (void)arg;
+}
+
+static void test_arbiter_no_timer(void)
+{
+    unsigned int jobs[HINT_SCHED_MAX_JOBS];
+    int list[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+    int num_jobs = 0, handle, i;
+
+    reset_downstream();
+
+    while (num_jobs < HINT_SCHED_MAX_JOBS &&
+            (jobs[num_jobs] = hint_schedule_call(60000, noop, NULL)) !=
+            HINT_SCHED_INVALID)
+        num_jobs++;
+
+    /* Without an expiry the request goes straight downstream, timed. */
+    handle = perf_arbiter_acquire(0, 100, list, ARRAY_SIZE(list));
+    EXPECT_EQ(1, downstream.acquired);
+    EXPECT_EQ(100, downstream.duration);
+    EXPECT_EQ(downstream.handle, handle);
+
+    for (i = 0; i < num_jobs; i++)
+        hint_schedule_cancel(jobs[i]);
+    perf_arbiter_release(handle);
+    EXPECT_EQ(1, downstream.released);
+}
+
+static void test_arbiter_sched_boost_level(void)
+{
+    int low[] = { SCHED_BOOST_ON_V3, 1 };
+    int high[] = { SCHED_BOOST_ON_V3, 2 };
+    int hl, hh;
+
+    reset_downstream();
+
+    /* The highest level wins, not the newest, and the other comes back. */
+    hh = perf_arbiter_acquire(0, 0, high, ARRAY_SIZE(high));
+    hl = perf_arbiter_acquire(0, 0, low, ARRAY_SIZE(low));
+    EXPECT_EQ(2, downstream.num_args);
+    EXPECT_EQ(2, downstream.list[1]);
+
+    perf_arbiter_release(hh);
+    EXPECT_EQ(2, downstream.num_args);
+    EXPECT_EQ(1, downstream.list[1]);
+
+    perf_arbiter_release(hl);
+    EXPECT_EQ(downstream.acquired, downstream.released);
+}
+
+/* hint-data.c's hash, to pick ids that collide. */
+static unsigned int hint_home(unsigned long hint_id)
+{
+    return (((unsigned int)hint_id * 2654435761u) >> 16) & (HINT_TABLE_SIZE - 1);
+}
+
+/* Finds 'count' ids whose home slot is 'home', starting after 'after'. */
+static unsigned long colliding_ids(unsigned int home, unsigned long after,
+        unsigned long *ids, int count)
+{
+    unsigned long id = after;
+    int n = 0;
+
+    while (n < count) {
+        if (hint_home(++id) == home)
+            ids[n++] = id;
+    }
+
+    return id;
+}
+
+static void test_hint_table_remove(void)
+{
+    /* Wraps past the end of the table, into the next home's run. */
+    unsigned int home = HINT_TABLE_SIZE - 2;
+    struct hint_table *table = calloc(1, sizeof(*table));
+    unsigned long ids[8];
+    struct hint_data hint = { 0 }, removed;
+    int removals[] = { 2, 0, 7, 5 };
+    int gone = 0, i, j;
+
+    colliding_ids(home, 0, ids, 5);
+    colliding_ids(0, 0, ids + 5, 3);
+    for (i = 0; i < 8; i++) {
+        hint.hint_id = ids[i];
+        hint.perflock_handle = i + 1;
+        EXPECT_EQ(0, hint_table_insert(table, &hint, NULL));
+    }
+
+    /* Out of the middle, the head, the wrapped tail and across the wrap. */
+    for (i = 0; i < (int)ARRAY_SIZE(removals); i++) {
+        EXPECT_EQ(0, hint_table_remove(table, ids[removals[i]], &removed));
+        EXPECT_EQ(removals[i] + 1, removed.perflock_handle);
+        gone |= 1 << removals[i];
+
+        for (j = 0; j < 8; j++) {
+            struct hint_data *found = hint_table_find(table, ids[j]);
+
+            if (gone & (1 << j)) {
+                EXPECT_EQ(1, found == NULL);
+            } else {
+                EXPECT_EQ(1, found != NULL);
+                EXPECT_EQ(j + 1, found ? found->perflock_handle : 0);
+            }
+        }
+    }
+    EXPECT_EQ(4, table->count);
+    EXPECT_EQ(-ENOENT, hint_table_remove(table, ids[2], NULL));
+
+    free(table);
+}
+
+static int boost_resources[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+
+static const struct boost_tier boost_tiers[] = {
+    BOOST_TIER(0, BOOST_PROFILE_NONE, boost_resources),
+};
+
+static const struct boost_config boost_config = {
+    .name = "test",
+    .default_duration = 100,
+    .min_duration = 0,
+    .max_duration = 5000,
+    .coalesce = 1,
+    .coalesce_window = 10,
+    .tiers = boost_tiers,
+    .num_tiers = ARRAY_SIZE(boost_tiers),
+};
+
+static void test_boost_coalescing(void)
+{
+    struct boost_engine engine = BOOST_ENGINE_INIT(&boost_config);
+    struct boost_stats stats;
+
+    reset_downstream();
+
+    boost_engine_boost(&engine, 100);
+    EXPECT_EQ(1, downstream.acquired);
+
+    /* Ends before the running boost does, so it is dropped... */
+    power_clock_advance(50 * NSINMS);
+    boost_engine_boost(&engine, 40);
+    /* ...as is one outlasting it by less than the window. */
+    boost_engine_boost(&engine, 55);
+    EXPECT_EQ(1, downstream.acquired);
+
+    /* One running past it renews the same lock. */
+    power_clock_advance(20 * NSINMS);
+    boost_engine_boost(&engine, 100);
+    EXPECT_EQ(1, engine.stats.extended);
+
+    /* Once it has run out, the next request starts a new boost. */
+    power_clock_advance(300 * NSINMS);
+    boost_engine_boost(&engine, 100);
+
+    boost_engine_get_stats(&engine, &stats);
+    EXPECT_EQ(2, stats.issued);
+    EXPECT_EQ(1, stats.extended);
+    EXPECT_EQ(2, stats.suppressed);
+
+    perf_lock_release(&engine.boost);
+    power_clock_advance(300 * NSINMS);
+    EXPECT_EQ(downstream.acquired, downstream.released);
+}
+
+static void test_delayed_perform(void)
+{
+    int list[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+    unsigned int job;
+
+    reset_downstream();
+
+    /* As the 8994 video encode hint: taken two seconds after the request. */
+    job = hint_schedule_perform(2000, DEFAULT_VIDEO_ENCODE_HINT_ID, list,
+            ARRAY_SIZE(list));
+    EXPECT_EQ(1, job != HINT_SCHED_INVALID);
+
+    power_clock_advance(1999 * NSINMS);
+    EXPECT_EQ(0, downstream.acquired);
+    power_clock_advance(NSINMS);
+    EXPECT_EQ(1, downstream.acquired);
+
+    /* Cancelled while pending, it never runs. */
+    job = hint_schedule_perform(2000, DEFAULT_VIDEO_DECODE_HINT_ID, list,
+            ARRAY_SIZE(list));
+    power_clock_advance(1000 * NSINMS);
+    EXPECT_EQ(0, hint_schedule_cancel(job));
+    power_clock_advance(2000 * NSINMS);
+    EXPECT_EQ(1, downstream.acquired);
+
+    undo_hint_action(DEFAULT_VIDEO_ENCODE_HINT_ID);
+    EXPECT_EQ(1, downstream.released);
+}
+
+/* Counts the jobs the scheduler could still take. */
+static int free_sched_jobs(void)
+{
+    unsigned int jobs[HINT_SCHED_MAX_JOBS];
+    int num_jobs = 0, i;
+
+    while (num_jobs < HINT_SCHED_MAX_JOBS &&
+            (jobs[num_jobs] = hint_schedule_call(60000, noop, NULL)) !=
+            HINT_SCHED_INVALID)
+        num_jobs++;
+
+    for (i = 0; i < num_jobs; i++)
+        hint_schedule_cancel(jobs[i]);
+
+    return num_jobs;
+}
+
+static void test_interaction_trace_one_job(void)
+{
+    int list[] = { MIN_FREQ_BIG_CORE_0, 1500 };
+    char path[] = "/tmp/power-hal-trace.XXXXXX";
+    char buf[8192], *last;
+    int free_jobs, handle = 0, i;
+    ssize_t len;
+
+    reset_downstream();
+    power_trace_fd = mkstemp(path);
+    unlink(path);
+    free_jobs = free_sched_jobs();
+
+    /* A fling extends the same boost every frame. */
+    for (i = 0; i < 40; i++) {
+        handle = interaction_with_handle(handle, 500, ARRAY_SIZE(list), list);
+        power_clock_advance(10 * NSINMS);
+    }
+    EXPECT_EQ(free_jobs - 2, free_sched_jobs());
+
+    /* The counter drops once, when the last extension runs out. */
+    power_clock_advance(500 * NSINMS);
+    len = pread(power_trace_fd, buf, sizeof(buf) - 1, 0);
+    buf[len > 0 ? len : 0] = '\0';
+    last = strrchr(buf, 'C');
+    EXPECT_EQ(1, last && strstr(last, "boost:interaction|0") &&
+            strstr(buf, "boost:interaction|0") == strstr(last, "boost:interaction|0"));
+    EXPECT_EQ(free_jobs, free_sched_jobs());
+
+    close(power_trace_fd);
+    power_trace_fd = -1;
+    perf_arbiter_release(handle);
+}
+
+/* The stand-in perfd utils.c dlopen()ed, resolved in main(). */
+static int (*stub_lock_acq)(unsigned long handle, int duration, int list[],
+        int num_args);
+static int (*stub_lock_rel)(unsigned long handle);
+static perf_stub_take_calls_fn stub_take_calls;
+static perf_stub_fail_next_fn stub_fail_next;
+
+static struct perf_stub_call calls[PERF_STUB_MAX_CALLS];
+static int num_calls;
+
+static int load_stub(void)
+{
+    void *handle = dlopen("libqti-perfd-client.so", RTLD_NOW | RTLD_NOLOAD);
+
+    if (!handle)
+        return -1;
+
+    stub_lock_acq = dlsym(handle, "perf_lock_acq");
+    stub_lock_rel = dlsym(handle, "perf_lock_rel");
+    stub_take_calls = dlsym(handle, "perf_stub_take_calls");
+    stub_fail_next = dlsym(handle, "perf_stub_fail_next");
+    dlclose(handle);
+
+    return stub_lock_acq && stub_lock_rel && stub_take_calls && stub_fail_next ?
+            0 : -1;
+}
+
+/* Fetches what reached perfd since the previous call. */
+static void take_calls(void)
+{
+    num_calls = stub_take_calls(calls, PERF_STUB_MAX_CALLS);
+}
+
+static int stub_acquire(int handle, int duration, int list[], int num_args)
+{
+    return stub_lock_acq(handle, duration, list, num_args);
+}
+
+static int stub_release(int handle)
+{
+    return stub_lock_rel(handle);
+}
+
+/* Puts the stub back behind the arbiter and forgets earlier calls. */
+static void reset_stub(void)
+{
+    static const struct perf_arbiter_ops ops = {
+        .acquire = stub_acquire,
+        .release = stub_release,
+    };
+
+    perf_arbiter_init(&ops);
+    take_calls();
+}
+
+/* The value 'call' set for v3 'opcode', or -1 if it didn't. */
+static int call_value(const struct perf_stub_call *call, int opcode)
+{
+    int i;
+
+    for (i = 0; i + 1 < call->num_args; i += 2) {
+        if (call->list[i] == opcode)
+            return call->list[i + 1];
+    }
+
+    return -1;
+}
+
+static void test_batch_merge(void)
+{
+    const struct perf_batch_ops ops = {
+        .acquire = stub_lock_acq,
+        .release = stub_lock_rel,
+    };
+    int a[] = { MIN_FREQ_BIG_CORE_0, 1200, MAX_FREQ_BIG_CORE_0, 1800,
+            ALL_CPUS_PWR_CLPS_DIS_V3, 1 };
+    int b[] = { MIN_FREQ_BIG_CORE_0, 1500, MAX_FREQ_BIG_CORE_0, 1600,
+            SCHED_PREFER_IDLE_DIS_V3, 1 };
+    int handle_a, handle_b, merged;
+
+    perf_batch_setup(&ops, 500);
+    take_calls();
+
+    handle_a = perf_batch_acquire(0, 0, a, ARRAY_SIZE(a));
+    power_clock_advance(200 * NSINUS);
+    handle_b = perf_batch_acquire(0, 0, b, ARRAY_SIZE(b));
+    take_calls();
+    EXPECT_EQ(0, num_calls);
+
+    /* One lock for both: highest floor, lowest cap, both flags. */
+    power_clock_advance(300 * NSINUS);
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(PERF_STUB_ACQ, calls[0].op);
+    EXPECT_EQ(1500, call_value(&calls[0], MIN_FREQ_BIG_CORE_0));
+    EXPECT_EQ(1600, call_value(&calls[0], MAX_FREQ_BIG_CORE_0));
+    EXPECT_EQ(1, call_value(&calls[0], ALL_CPUS_PWR_CLPS_DIS_V3));
+    EXPECT_EQ(1, call_value(&calls[0], SCHED_PREFER_IDLE_DIS_V3));
+    merged = calls[0].ret;
+
+    /* Without b, a's lock is taken before the merged one goes. */
+    EXPECT_EQ(0, perf_batch_release(handle_b));
+    power_clock_advance(500 * NSINUS);
+    take_calls();
+    EXPECT_EQ(2, num_calls);
+    EXPECT_EQ(PERF_STUB_ACQ, calls[0].op);
+    EXPECT_EQ(0, calls[0].handle);
+    EXPECT_EQ(1200, call_value(&calls[0], MIN_FREQ_BIG_CORE_0));
+    EXPECT_EQ(1800, call_value(&calls[0], MAX_FREQ_BIG_CORE_0));
+    EXPECT_EQ(1, call_value(&calls[0], ALL_CPUS_PWR_CLPS_DIS_V3));
+    EXPECT_EQ(-1, call_value(&calls[0], SCHED_PREFER_IDLE_DIS_V3));
+    EXPECT_EQ(PERF_STUB_REL, calls[1].op);
+    EXPECT_EQ(merged, calls[1].handle);
+
+    EXPECT_EQ(0, perf_batch_release(handle_a));
+    power_clock_advance(500 * NSINUS);
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(PERF_STUB_REL, calls[0].op);
+
+    perf_batch_setup(&ops, 0);
+}
+
+/* As on 8998. */
+static const struct perf_mode_hint mode_hints[] = {
+    { PERF_MODE_SUSTAINED, SUSTAINED_PERF_HINT },
+    { PERF_MODE_VR, VR_MODE_HINT },
+    { PERF_MODE_VR | PERF_MODE_SUSTAINED, VR_MODE_SUSTAINED_PERF_HINT },
+};
+
+static void test_perf_mode_switch(void)
+{
+    struct perf_mode_engine modes = PERF_MODE_ENGINE_INIT(mode_hints);
+    int sustained, combined;
+
+    reset_stub();
+
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_SUSTAINED, 1));
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(PERF_STUB_HINT, calls[0].op);
+    EXPECT_EQ(SUSTAINED_PERF_HINT, calls[0].hint_id);
+    sustained = calls[0].ret;
+
+    /* Both on have a row of their own, taken before the old hint goes. */
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_VR, 1));
+    take_calls();
+    EXPECT_EQ(2, num_calls);
+    EXPECT_EQ(PERF_STUB_HINT, calls[0].op);
+    EXPECT_EQ(VR_MODE_SUSTAINED_PERF_HINT, calls[0].hint_id);
+    EXPECT_EQ(PERF_STUB_REL, calls[1].op);
+    EXPECT_EQ(sustained, calls[1].handle);
+    combined = calls[0].ret;
+
+    /* A failed switch keeps the modes and the lock it had. */
+    stub_fail_next(1);
+    EXPECT_EQ(HINT_NONE, perf_mode_set(&modes, PERF_MODE_VR, 0));
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(SUSTAINED_PERF_HINT, calls[0].hint_id);
+    EXPECT_EQ(PERF_MODE_VR | PERF_MODE_SUSTAINED, perf_mode_current(&modes));
+    EXPECT_EQ(combined, modes.held.handle);
+
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_VR, 0));
+    take_calls();
+    EXPECT_EQ(2, num_calls);
+    EXPECT_EQ(SUSTAINED_PERF_HINT, calls[0].hint_id);
+    EXPECT_EQ(PERF_STUB_REL, calls[1].op);
+    EXPECT_EQ(combined, calls[1].handle);
+
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_SUSTAINED, 0));
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(PERF_STUB_REL, calls[0].op);
+    EXPECT_EQ(PERF_MODE_NORMAL, perf_mode_current(&modes));
+}
+
+/*
+ * Whether perfd held at least one lock after every call it got, starting
+ * from 'held' locks. Returns the locks held at the end, or 0.
+ */
+static int held_throughout(int held)
+{
+    int i;
+
+    for (i = 0; i < num_calls; i++) {
+        if (calls[i].op == PERF_STUB_REL)
+            held--;
+        else if (calls[i].op == PERF_STUB_ACQ && !calls[i].handle && calls[i].ret > 0)
+            held++;
+        if (held < 1)
+            return 0;
+    }
+
+    return held;
+}
+
+/* The perf lock handle active hint 'hint_id' holds, or 0. */
+static unsigned long hint_handle(unsigned long hint_id)
+{
+    struct hint_data hints[HINT_TABLE_SIZE];
+    unsigned int count = get_active_hints(hints, HINT_TABLE_SIZE);
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        if (hints[i].hint_id == hint_id)
+            return hints[i].perflock_handle;
+    }
+
+    return 0;
+}
+
+static void test_transition_hint(void)
+{
+    int a[] = { MIN_FREQ_BIG_CORE_0, 1200 };
+    int b[] = { MIN_FREQ_LITTLE_CORE_0, 1000 };
+    const struct perf_stub_call *last;
+    unsigned long handle;
+
+    reset_stub();
+
+    EXPECT_EQ(0, perform_hint_action(DISPLAY_STATE_HINT_ID, a, ARRAY_SIZE(a)));
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+
+    /* As on 8974 when the display goes on: the new lock comes first. */
+    EXPECT_EQ(0, transition_hint_action(DISPLAY_STATE_HINT_ID,
+            DISPLAY_STATE_HINT_ID_2, b, ARRAY_SIZE(b)));
+    take_calls();
+    EXPECT_EQ(1, held_throughout(1));
+    EXPECT_EQ(PERF_STUB_REL, calls[num_calls - 1].op);
+    last = &calls[num_calls - 2];
+    EXPECT_EQ(PERF_STUB_ACQ, last->op);
+    EXPECT_EQ(-1, call_value(last, MIN_FREQ_BIG_CORE_0));
+    EXPECT_EQ(1000, call_value(last, MIN_FREQ_LITTLE_CORE_0));
+
+    /* Same resources: the lock moves to the other id without a call. */
+    handle = hint_handle(DISPLAY_STATE_HINT_ID_2);
+    EXPECT_EQ(0, transition_hint_action(DISPLAY_STATE_HINT_ID_2,
+            DISPLAY_STATE_HINT_ID, b, ARRAY_SIZE(b)));
+    take_calls();
+    EXPECT_EQ(0, num_calls);
+    EXPECT_EQ(0, hint_handle(DISPLAY_STATE_HINT_ID_2));
+    EXPECT_EQ(1, handle && hint_handle(DISPLAY_STATE_HINT_ID) == handle);
+
+    undo_hint_action(DISPLAY_STATE_HINT_ID);
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(PERF_STUB_REL, calls[0].op);
+}
+
+static void test_perf_mode_same_hint(void)
+{
+    static const struct perf_mode_hint shared_hints[] = {
+        { PERF_MODE_GAMING, SUSTAINED_PERF_HINT },
+        { PERF_MODE_GAMING | PERF_MODE_CAMERA, SUSTAINED_PERF_HINT },
+    };
+    struct perf_mode_engine modes = PERF_MODE_ENGINE_INIT(shared_hints);
+    int handle;
+
+    reset_stub();
+
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_GAMING, 1));
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    handle = calls[0].ret;
+
+    /* Both combinations map to the same hint, so perfd isn't bothered. */
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_CAMERA, 1));
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_CAMERA, 0));
+    take_calls();
+    EXPECT_EQ(0, num_calls);
+    EXPECT_EQ(handle, modes.held.handle);
+
+    EXPECT_EQ(HINT_HANDLED, perf_mode_set(&modes, PERF_MODE_GAMING, 0));
+    take_calls();
+    EXPECT_EQ(1, num_calls);
+    EXPECT_EQ(handle, calls[0].handle);
+}
+
+/* Leaves a journal behind as an instance that died would have. */
+static int write_journal(const char *path, const struct lock_journal_entry *left,
+        int num_left)
+{
+    struct {
+        struct lock_journal_header header;
+        struct lock_journal_entry entries[LOCK_JOURNAL_ENTRIES];
+    } journal;
+    int fd, ret;
+
+    memset(&journal, 0, sizeof(journal));
+    journal.header.magic = LOCK_JOURNAL_MAGIC;
+    journal.header.version = LOCK_JOURNAL_VERSION;
+    journal.header.entry_size = sizeof(struct lock_journal_entry);
+    journal.header.num_entries = LOCK_JOURNAL_ENTRIES;
+    fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    ret = read(fd, journal.header.boot_id, LOCK_JOURNAL_BOOT_ID_SIZE - 1);
+    close(fd);
+    if (ret <= 0)
+        return -EIO;
+    memcpy(journal.entries, left, num_left * sizeof(left[0]));
+
+    fd = open(path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    ret = write(fd, &journal, sizeof(journal)) == sizeof(journal) ? 0 : -EIO;
+    close(fd);
+
+    return ret;
+}
+
+static void test_journal_replay(void)
+{
+    char path[] = "/tmp/power-hal-journal.XXXXXX";
+    struct lock_journal_entry left[3], recovered[LOCK_JOURNAL_ENTRIES];
+    unsigned long long start = hint_client_start_time(getpid());
+    int fd, count;
+
+    memset(left, 0, sizeof(left));
+    /* An indefinite perf_hint() lock, now orphaned. */
+    left[0].kind = LOCK_JOURNAL_PERFD;
+    left[0].id = 0x1234;
+    /* A display hint whose owner is still the same process. */
+    left[1].kind = LOCK_JOURNAL_HINT;
+    left[1].id = DISPLAY_STATE_HINT_ID;
+    left[1].owner_pid = getpid();
+    left[1].owner_uid = getuid();
+    left[1].owner_start = start;
+    left[1].num_resources = 2;
+    left[1].resources[0] = MIN_FREQ_BIG_CORE_0;
+    left[1].resources[1] = 1200;
+    /* One whose owner's pid has been reused since. */
+    left[2] = left[1];
+    left[2].id = DISPLAY_STATE_HINT_ID_2;
+    left[2].owner_start = start + 1;
+
+    fd = mkstemp(path);
+    EXPECT_EQ(1, fd >= 0 && start);
+    close(fd);
+    EXPECT_EQ(0, write_journal(path, left, ARRAY_SIZE(left)));
+
+    reset_stub();
+    count = lock_journal_open(path, recovered, LOCK_JOURNAL_ENTRIES);
+    EXPECT_EQ(3, count);
+    replay_hint_locks(recovered, count);
+    unlink(path);
+
+    /* The display hint is taken again before the orphan is released. */
+    take_calls();
+    EXPECT_EQ(2, num_calls);
+    EXPECT_EQ(PERF_STUB_ACQ, calls[0].op);
+    EXPECT_EQ(1200, call_value(&calls[0], MIN_FREQ_BIG_CORE_0));
+    EXPECT_EQ(PERF_STUB_REL, calls[1].op);
+    EXPECT_EQ(0x1234, calls[1].handle);
+    EXPECT_EQ(1, hint_handle(DISPLAY_STATE_HINT_ID) != 0);
+    EXPECT_EQ(0, hint_handle(DISPLAY_STATE_HINT_ID_2));
+
+    undo_hint_action(DISPLAY_STATE_HINT_ID);
+}
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} tests[] = {
+    { "metadata_whitespace", test_metadata_whitespace },
+    { "hint_table_remove", test_hint_table_remove },
+    { "native_root_too_long", test_native_root_too_long },
+    { "native_writes", test_native_writes },
+    { "native_overlap", test_native_overlap },
+    { "native_restore", test_native_restore },
+    { "native_expiry", test_native_expiry },
+    { "arbiter_one_lock_per_change", test_arbiter_one_lock_per_change },
+    { "arbiter_timed", test_arbiter_timed },
+    { "arbiter_no_timer", test_arbiter_no_timer },
+    { "arbiter_sched_boost_level", test_arbiter_sched_boost_level },
+    { "interaction_trace_one_job", test_interaction_trace_one_job },
+    { "boost_coalescing", test_boost_coalescing },
+    { "delayed_perform", test_delayed_perform },
+    { "batch_merge", test_batch_merge },
+    { "perf_mode_switch", test_perf_mode_switch },
+    { "perf_mode_same_hint", test_perf_mode_same_hint },
+    { "transition_hint", test_transition_hint },
+    { "journal_replay", test_journal_replay },
+};
+
+int main(void)
+{
+    unsigned int i;
+
+    /* Timers only fire when a test steps the clock. */
+    power_clock_simulate(1000 * NSINMS);
+
+    if (make_native_tree() || perf_native_init(native_root)) {
+        fprintf(stderr, "Unable to create a fake sysfs tree in %s\n", native_root);
+        return 1;
+    }
+
+    if (load_stub()) {
+        fprintf(stderr, "The stand-in libqti-perfd-client.so was not loaded\n");
+        return 1;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(tests); i++) {
+        int before = failures;
+
+        tests[i].run();
+        printf("%-32s %s\n", tests[i].name, failures == before ? "ok" : "FAILED");
+    }
+
+    remove_native_tree();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host benchmark for the hint dispatch path.
+ *
+ * Links the real power-helper/utils/metadata code and one power-XXXX.c
+ * backend, lets utils.c dlopen() the stand-in libqti-perfd-client.so and
+ * reports per-call latency percentiles for the HAL entry points.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/power.h>
+
+#include "hint-stats.h"
+#include "power-common.h"
+#include "power-helper.h"
+
+#ifndef RPM_SYSTEM_STAT
+#define RPM_SYSTEM_STAT "/tmp/power-hint-bench/system_stats"
+#endif
+
+#ifndef BOOST_PROFILE_PATH
+#define BOOST_PROFILE_PATH "/tmp/power-hint-bench/boost_profiles.xml"
+#endif
+
+#define DEFAULT_ITERATIONS 10000
+#define DEFAULT_WARMUP 100
+#define METADATA_SIZE 64
+
+struct bench_result {
+    const char *name;
+    uint64_t *samples;
+    size_t count;
+};
+
+static const char *system_stats_fixture =
+    "RPM Mode:vlow\n"
+    "\tcount:1234\n"
+    "\tactual last sleep(msec):5678\n"
+    "RPM Mode:vmin\n"
+    "\tcount:4321\n"
+    "\tactual last sleep(msec):8765\n"
+    "APSS\n"
+    "\tAccumulated XO duration:100000\n"
+    "\tXO Count:10\n"
+    "MPSS\n"
+    "\tAccumulated XO duration:200000\n"
+    "\tXO Count:20\n"
+    "ADSP\n"
+    "\tAccumulated XO duration:300000\n"
+    "\tXO Count:30\n"
+    "SLPI\n"
+    "\tAccumulated XO duration:400000\n"
+    "\tXO Count:40\n";
+
+/* Same shape as the built-in 8974 tables, for every governor. */
+static const char *boost_profile_fixture =
+    "<BoostProfiles>\n"
+    "    <Boost hint=\"interaction\">0x0702, 0x2E0, 0x30E, 0x40E, 0x50E</Boost>\n"
+    "    <Boost hint=\"fling\">0x0703, 0x2E0, 0x30E, 0x40E, 0x50E</Boost>\n"
+    "    <Boost hint=\"launch\">0x0702, 0x20F, 0x30F, 0x40F, 0x50F</Boost>\n"
+    "</BoostProfiles>\n";
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t count, double p)
+{
+    size_t idx = (size_t)(p * (count - 1) + 0.5);
+
+    return sorted[idx < count ? idx : count - 1];
+}
+
+static void report(struct bench_result *r)
+{
+    uint64_t sum = 0;
+    size_t i;
+
+    if (!r->count)
+        return;
+
+    qsort(r->samples, r->count, sizeof(uint64_t), compare_u64);
+    for (i = 0; i < r->count; i++)
+        sum += r->samples[i];
+
+    printf("%-32s %8zu %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64
+            " %9" PRIu64 " %9" PRIu64 "\n",
+            r->name, r->count, sum / r->count,
+            percentile(r->samples, r->count, 0.50),
+            percentile(r->samples, r->count, 0.90),
+            percentile(r->samples, r->count, 0.99),
+            percentile(r->samples, r->count, 0.999),
+            r->samples[r->count - 1]);
+}
+
+static int write_fixture(const char *path, const char *contents)
+{
+    char dir[PATH_MAX];
+    char *slash;
+    FILE *fp;
+
+    strncpy(dir, path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    slash = strrchr(dir, '/');
+    if (slash) {
+        *slash = '\0';
+        if (mkdir(dir, 0755) && errno != EEXIST)
+            return -errno;
+    }
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -errno;
+    fputs(contents, fp);
+    fclose(fp);
+
+    return 0;
+}
+
+static void bench_interaction(struct bench_result *r, size_t iterations)
+{
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        /* Alternate short taps and flings so both boost tiers are hit. */
+        int duration = (i & 1) ? 2000 : 100;
+        uint64_t start = now_ns();
+
+        power_hint(POWER_HINT_INTERACTION, &duration);
+        r->samples[r->count++] = now_ns() - start;
+    }
+}
+
+static void bench_launch(struct bench_result *r, size_t iterations)
+{
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        int launch = 1;
+        uint64_t start = now_ns();
+
+        power_hint(POWER_HINT_LAUNCH, &launch);
+        r->samples[r->count++] = now_ns() - start;
+    }
+}
+
+static void bench_video_encode(struct bench_result *r, size_t iterations)
+{
+    char metadata[METADATA_SIZE];
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        uint64_t start;
+
+        snprintf(metadata, sizeof(metadata), "state=%d;hint_id=%d",
+                (int)((i + 1) & 1), 0x0A00);
+        start = now_ns();
+        power_hint(POWER_HINT_VIDEO_ENCODE, metadata);
+        r->samples[r->count++] = now_ns() - start;
+    }
+}
+
+static void bench_set_interactive(struct bench_result *r, size_t iterations)
+{
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+
+        power_set_interactive(i & 1);
+        r->samples[r->count++] = now_ns() - start;
+    }
+    power_set_interactive(1);
+}
+
+static void bench_platform_stats(struct bench_result *r, size_t iterations)
+{
+    uint64_t stats[MAX_PLATFORM_STATS * MAX_RPM_PARAMS];
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+
+        extract_platform_stats(stats);
+        r->samples[r->count++] = now_ns() - start;
+    }
+}
+
+static void bench_platform_stats_cached(struct bench_result *r, size_t iterations)
+{
+    uint64_t stats[MAX_PLATFORM_STATS * MAX_RPM_PARAMS];
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        uint64_t start = now_ns();
+
+        extract_platform_stats_cached(stats, false);
+        r->samples[r->count++] = now_ns() - start;
+    }
+}
+
+static void print_perfd_counters(void)
+{
+    void (*get_counters)(unsigned long *, unsigned long *, unsigned long *);
+    unsigned long acq, rel, hint;
+    void *handle;
+
+    handle = dlopen("libqti-perfd-client.so", RTLD_NOW | RTLD_NOLOAD);
+    if (!handle) {
+        printf("\nstand-in perf HAL was not loaded; perf calls were skipped\n");
+        return;
+    }
+
+    get_counters = dlsym(handle, "perf_stub_get_counters");
+    if (get_counters) {
+        get_counters(&acq, &rel, &hint);
+        printf("\nperfd calls: perf_lock_acq=%lu perf_lock_rel=%lu perf_hint=%lu\n",
+                acq, rel, hint);
+    }
+    dlclose(handle);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-w warmup] [-p] [-s]\n"
+            "  -p  load boost resources from an XML profile\n"
+            "  -s  print the HAL's own hint statistics afterwards\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_result results[] = {
+        { "power_hint(INTERACTION)", NULL, 0 },
+        { "power_hint(LAUNCH)", NULL, 0 },
+        { "power_hint(VIDEO_ENCODE)", NULL, 0 },
+        { "power_set_interactive()", NULL, 0 },
+        { "extract_platform_stats()", NULL, 0 },
+        { "extract_platform_stats_cached()", NULL, 0 },
+    };
+    void (*benches[])(struct bench_result *, size_t) = {
+        bench_interaction,
+        bench_launch,
+        bench_video_encode,
+        bench_set_interactive,
+        bench_platform_stats,
+        bench_platform_stats_cached,
+    };
+    size_t iterations = DEFAULT_ITERATIONS;
+    size_t warmup = DEFAULT_WARMUP;
+    int use_profile = 0;
+    int dump_stats = 0;
+    size_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:psh")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                warmup = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                use_profile = 1;
+                break;
+            case 's':
+                dump_stats = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (iterations == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (write_fixture(RPM_SYSTEM_STAT, system_stats_fixture)) {
+        fprintf(stderr, "Unable to create %s\n", RPM_SYSTEM_STAT);
+        return 1;
+    }
+
+    unlink(BOOST_PROFILE_PATH);
+    if (use_profile && write_fixture(BOOST_PROFILE_PATH, boost_profile_fixture)) {
+        fprintf(stderr, "Unable to create %s\n", BOOST_PROFILE_PATH);
+        return 1;
+    }
+
+    power_init();
+
+    for (i = 0; i < ARRAY_SIZE(results); i++) {
+        size_t len = warmup > iterations ? warmup : iterations;
+
+        results[i].samples = calloc(len, sizeof(uint64_t));
+        if (!results[i].samples) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+
+        benches[i](&results[i], warmup);
+        results[i].count = 0;
+        benches[i](&results[i], iterations);
+    }
+
+    printf("%-32s %8s %9s %9s %9s %9s %9s %9s\n", "call (ns)", "count",
+            "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (i = 0; i < ARRAY_SIZE(results); i++) {
+        report(&results[i]);
+        free(results[i].samples);
+    }
+
+    print_perfd_counters();
+
+    if (dump_stats) {
+        printf("\n");
+        fflush(stdout);
+        hint_stats_dump(STDOUT_FILENO);
+    }
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host replayer for logs written by the HAL's hint recorder.
+ *
+ * Links the same dispatch code as power-hint-bench and feeds every
+ * recorded power_hint(), power_set_interactive() and set_feature() call
+ * back through it, against the stand-in libqti-perfd-client.so. Calls
+ * are replayed at their original spacing, or back to back with -f, and
+ * timed per entry point through the HAL's own hint statistics.
+ *
+ * With -v the original spacing is kept on a simulated power clock
+ * instead: every coalescing window, lock lifetime and delayed hint
+ * plays out exactly as recorded, but without waiting for it.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/power.h>
+
+#include "hint-recorder.h"
+#include "hint-scheduler.h"
+#include "hint-stats.h"
+#include "power-clock.h"
+#include "power-common.h"
+#include "power-helper.h"
+
+/* Where a simulated clock starts; anything positive works. */
+#define SIMULATED_START_NS 1000000000LL
+
+struct replay_log {
+    struct hint_record_header header;
+    struct hint_record *records;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int load_log(const char *path, struct replay_log *log)
+{
+    size_t size;
+    FILE *fp;
+    int ret = 0;
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return -errno;
+
+    if (fread(&log->header, sizeof(log->header), 1, fp) != 1 ||
+            log->header.magic != HINT_RECORD_MAGIC ||
+            log->header.version != HINT_RECORD_VERSION ||
+            log->header.record_size != sizeof(struct hint_record) ||
+            log->header.capacity == 0) {
+        fclose(fp);
+        return -EINVAL;
+    }
+
+    size = (size_t)log->header.capacity * sizeof(struct hint_record);
+    log->records = malloc(size);
+    if (!log->records)
+        ret = -ENOMEM;
+    else if (fread(log->records, size, 1, fp) != 1)
+        ret = -EINVAL;
+
+    fclose(fp);
+    return ret;
+}
+
+/* Runs one record through the HAL, timed like the HIDL entry points. */
+static void dispatch(const struct hint_record *record)
+{
+    char meta[HINT_RECORD_META_SIZE + 1];
+    int value = record->value;
+    uint64_t start = hint_stats_begin();
+
+    switch (record->type) {
+        case HINT_RECORD_POWER_HINT:
+            if (record->flags & HINT_RECORD_NULL_DATA) {
+                power_hint(record->code, NULL);
+            } else if (record->meta_len) {
+                memcpy(meta, record->meta, record->meta_len);
+                meta[record->meta_len] = '\0';
+                power_hint(record->code, meta);
+            } else {
+                power_hint(record->code, &value);
+            }
+            hint_stats_end(hint_stats_power_hint_id(record->code), start);
+            break;
+        case HINT_RECORD_SET_INTERACTIVE:
+            power_set_interactive(value);
+            hint_stats_end(HINT_STATS_SET_INTERACTIVE, start);
+            break;
+        case HINT_RECORD_SET_FEATURE:
+            set_feature(record->code, value);
+            hint_stats_end(HINT_STATS_SET_FEATURE, start);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Replays every intact record, oldest first. Returns how many ran and
+ * stores how many were skipped because they were torn or unknown.
+ */
+static uint64_t replay(const struct replay_log *log, int fast, uint64_t *skipped)
+{
+    uint64_t head = log->header.head;
+    uint64_t capacity = log->header.capacity;
+    uint64_t first = head > capacity ? head - capacity : 0;
+    long long base_ns = 0;
+    uint64_t origin_ns = 0, count = 0;
+    uint64_t i;
+
+    for (i = first; i < head; i++) {
+        const struct hint_record *record = &log->records[i % capacity];
+
+        if (record->seq != i + 1 || record->type < HINT_RECORD_POWER_HINT ||
+                record->type > HINT_RECORD_SET_FEATURE) {
+            (*skipped)++;
+            continue;
+        }
+
+        if (!count) {
+            base_ns = power_clock_now_ns();
+            origin_ns = record->timestamp_ns;
+        } else if (!fast && record->timestamp_ns > origin_ns) {
+            /* Timestamps go back after a reboot; those run right away. */
+            power_clock_sleep_until(base_ns + (record->timestamp_ns - origin_ns));
+        }
+
+        dispatch(record);
+        count++;
+    }
+
+    return count;
+}
+
+static void print_perfd_counters(void)
+{
+    void (*get_counters)(unsigned long *, unsigned long *, unsigned long *);
+    unsigned long acq, rel, hint;
+    void *handle;
+
+    handle = dlopen("libqti-perfd-client.so", RTLD_NOW | RTLD_NOLOAD);
+    if (!handle)
+        return;
+
+    get_counters = dlsym(handle, "perf_stub_get_counters");
+    if (get_counters) {
+        get_counters(&acq, &rel, &hint);
+        printf("perfd calls: perf_lock_acq=%lu perf_lock_rel=%lu perf_hint=%lu\n",
+                acq, rel, hint);
+    }
+    dlclose(handle);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-f | -v] [-l loops] [-s] log\n"
+            "  -f  replay as fast as possible instead of at recorded timing\n"
+            "  -v  keep recorded timing on a simulated clock\n"
+            "  -l  replay the log this many times\n"
+            "  -s  print the HAL's own hint statistics afterwards\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct replay_log log;
+    uint64_t count = 0, skipped = 0, start;
+    unsigned long loops = 1, i;
+    int fast = 0;
+    int simulate = 0;
+    int dump_stats = 0;
+    int opt, ret;
+
+    while ((opt = getopt(argc, argv, "fvl:sh")) != -1) {
+        switch (opt) {
+            case 'f':
+                fast = 1;
+                break;
+            case 'v':
+                simulate = 1;
+                break;
+            case 'l':
+                loops = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                dump_stats = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc - 1 || loops == 0 || (fast && simulate)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ret = load_log(argv[optind], &log);
+    if (ret) {
+        fprintf(stderr, "Unable to load %s: %s\n", argv[optind], strerror(-ret));
+        return 1;
+    }
+
+    if (simulate)
+        power_clock_simulate(SIMULATED_START_NS);
+
+    power_init();
+
+    start = now_ns();
+    for (i = 0; i < loops; i++)
+        count += replay(&log, fast, &skipped);
+
+    if (simulate) {
+        long long deadline;
+
+        /* Let every boost still held run out. */
+        while ((deadline = hint_schedule_next_deadline()))
+            power_clock_advance_to(deadline);
+        printf("simulated %lld ms\n",
+                (power_clock_now_ns() - SIMULATED_START_NS) / 1000000LL);
+    }
+
+    printf("replayed %" PRIu64 " call(s) in %" PRIu64 " us, skipped %" PRIu64 "\n",
+            count, (now_ns() - start) / 1000, skipped);
+    print_perfd_counters();
+
+    if (dump_stats) {
+        printf("\n");
+        fflush(stdout);
+        hint_stats_dump(STDOUT_FILENO);
+    }
+
+    free(log.records);
+    return 0;
+}
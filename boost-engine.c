@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Shared coalescing logic for timed boosts (interaction, launch, ...).
+ *
+ * Each SoC backend declares a boost_config with its resource tiers and
+ * owns one boost_engine per hint type. A request is dropped when the
+ * boost already running covers it, and renews the running perf lock in
+ * place when it outlasts it.
+ */
+
+#define LOG_NIDEBUG 0
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "boost-engine.h"
+#include "boost-profile.h"
+#include "hint-stats.h"
+#include "power-clock.h"
+#include "power-common.h"
+#include "utils.h"
+
+#define USINMS 1000LL
+
+static long long now_us(void)
+{
+    return power_clock_now_ns() / 1000LL;
+}
+
+static const struct boost_tier *select_tier(const struct boost_config *config,
+        int duration)
+{
+    int i;
+
+    for (i = 0; i < config->num_tiers; i++) {
+        if (duration >= config->tiers[i].min_duration)
+            return &config->tiers[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * Requests a boost of 'duration' ms, clamped to the configured limits.
+ * Always returns HINT_HANDLED; a suppressed request is still handled.
+ */
+int boost_engine_boost(struct boost_engine *engine, int duration)
+{
+    const struct boost_config *config = engine->config;
+    const struct boost_tier *tier;
+    int *resources;
+    int num_resources;
+    long long now, end;
+
+    if (duration < config->min_duration)
+        duration = config->min_duration;
+    if (duration > config->max_duration)
+        duration = config->max_duration;
+
+    tier = select_tier(config, duration);
+    if (!tier)
+        return HINT_HANDLED;
+
+    resources = boost_profile_lookup(tier->profile, &num_resources);
+    if (!resources) {
+        resources = tier->resources;
+        num_resources = tier->num_resources;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+
+    now = now_us();
+    end = now + duration * USINMS;
+
+    // don't hint if previous hint's duration covers this hint's duration
+    if (config->coalesce &&
+            engine->last_end_us + config->coalesce_window * USINMS > end) {
+        engine->stats.suppressed++;
+        hint_stats_note(HINT_OUTCOME_SUPPRESSED);
+        pthread_mutex_unlock(&engine->lock);
+        return HINT_HANDLED;
+    }
+
+    if (now < engine->last_end_us)
+        engine->stats.extended++;
+    else
+        engine->stats.issued++;
+    engine->last_end_us = end;
+
+    if (tier->vendor_hint) {
+        perf_hint_enable_with_type(tier->vendor_hint, duration,
+                tier->vendor_hint_type);
+    } else {
+        /* Renews a running lock instead of stacking. */
+        perf_lock_acquire(&engine->boost, duration, resources, num_resources);
+    }
+
+    pthread_mutex_unlock(&engine->lock);
+
+    return HINT_HANDLED;
+}
+
+/* Entry point for power hints whose data is an optional duration in ms. */
+int boost_engine_hint(struct boost_engine *engine, void *data)
+{
+    int duration = engine->config->default_duration;
+
+    if (data) {
+        int input_duration = *((int *)data);
+        if (input_duration > duration)
+            duration = input_duration;
+    }
+
+    return boost_engine_boost(engine, duration);
+}
+
+void boost_engine_get_stats(struct boost_engine *engine,
+        struct boost_stats *stats)
+{
+    pthread_mutex_lock(&engine->lock);
+    *stats = engine->stats;
+    pthread_mutex_unlock(&engine->lock);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_BOOST_ENGINE_H
+#define _QCOM_POWER_BOOST_ENGINE_H
+
+#include <pthread.h>
+
+#include "boost-profile.h"
+#include "perf-lock.h"
+
+/*
+ * A boost tier is used for requests lasting at least min_duration ms.
+ * It either names a resource list for perf_lock_acq() or, when
+ * vendor_hint is non-zero, a perf_hint() id and type. A device boost
+ * profile for 'profile', if loaded, replaces the built-in resources.
+ */
+struct boost_tier {
+    int min_duration;
+    enum boost_profile_id profile;
+    int *resources;
+    int num_resources;
+    int vendor_hint;
+    int vendor_hint_type;
+};
+
+#define BOOST_TIER(min, profile, res) \
+    { (min), (profile), (res), ARRAY_SIZE(res), 0, 0 }
+#define BOOST_TIER_VENDOR(min, hint, type) \
+    { (min), BOOST_PROFILE_NONE, NULL, 0, (hint), (type) }
+
+struct boost_config {
+    const char *name;
+    int default_duration;   /* ms, when the hint carries no duration */
+    int min_duration;       /* ms */
+    int max_duration;       /* ms */
+    int coalesce;           /* skip boosts covered by the previous one */
+    int coalesce_window;    /* ms a new boost may outlast the old and still be skipped */
+    const struct boost_tier *tiers; /* by descending min_duration */
+    int num_tiers;
+};
+
+struct boost_stats {
+    unsigned long issued;       /* boosts started while none was active */
+    unsigned long extended;     /* boosts renewed while one was active */
+    unsigned long suppressed;   /* requests covered by the active boost */
+};
+
+struct boost_engine {
+    const struct boost_config *config;
+    pthread_mutex_t lock;
+    long long last_end_us;
+    struct perf_lock boost;
+    struct boost_stats stats;
+};
+
+#define BOOST_ENGINE_INIT(cfg) \
+    { .config = (cfg), .lock = PTHREAD_MUTEX_INITIALIZER, .boost = PERF_LOCK_INIT }
+
+int boost_engine_hint(struct boost_engine *engine, void *data);
+int boost_engine_boost(struct boost_engine *engine, int duration);
+void boost_engine_get_stats(struct boost_engine *engine,
+        struct boost_stats *stats);
+
+#endif
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Loads per-device boost resource lists from XML, so boosts can be
+ * tuned without rebuilding the HAL:
+ *
+ * <BoostProfiles>
+ *     <Boost hint="fling" governor="interactive" soc="246,291">
+ *         0x41000000, 0x5DC, 0x40400000, 0x1
+ *     </Boost>
+ * </BoostProfiles>
+ *
+ * 'hint' is one of the names in profile_names[]. 'governor' and 'soc'
+ * are optional and entries for other SoCs are dropped at load time.
+ * When several entries apply, one naming the SoC beats one naming only
+ * the governor, which beats a generic one; otherwise the last one wins.
+ *
+ * Everything is resolved into one packed array during power_init(), so
+ * a lookup is a table index and the returned list must not be modified.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "boost-profile.h"
+#include "power-common.h"
+
+#define BOOST_PROFILE_MAX_RESOURCES 64
+
+#define MATCH_GOVERNOR (1 << 0)
+#define MATCH_SOC (1 << 1)
+
+struct boost_profile_slot {
+    unsigned short offset;
+    unsigned short count;
+};
+
+/* One parsed <Boost> element while loading. */
+struct boost_profile_entry {
+    int values[BOOST_PROFILE_MAX_RESOURCES];
+    int count;
+    int pool_offset;
+};
+
+static const char *profile_names[BOOST_PROFILE_COUNT] = {
+    [BOOST_PROFILE_INTERACTION] = "interaction",
+    [BOOST_PROFILE_FLING] = "fling",
+    [BOOST_PROFILE_LAUNCH] = "launch",
+    [BOOST_PROFILE_VIDEO_ENCODE] = "video_encode",
+    [BOOST_PROFILE_VIDEO_DECODE] = "video_decode",
+    [BOOST_PROFILE_DISPLAY_OFF] = "display_off",
+};
+
+static struct boost_profile_slot profile_slots[BOOST_PROFILE_COUNT][GOVERNOR_TYPE_COUNT];
+/* Hints whose resources differ between governors. */
+static bool profile_per_governor[BOOST_PROFILE_COUNT];
+static int *profile_pool;
+static atomic_bool profiles_loaded;
+
+static enum boost_profile_id profile_from_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < BOOST_PROFILE_COUNT; i++) {
+        if (!strcmp(name, profile_names[i]))
+            return i;
+    }
+
+    return BOOST_PROFILE_NONE;
+}
+
+/* Parses a comma or whitespace separated list of integers. */
+static int parse_values(const char *text, int *values, int max_values)
+{
+    const char *p = text;
+    int count = 0;
+
+    while (*p) {
+        char *end;
+        long value;
+
+        while (*p == ',' || *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+            p++;
+        if (!*p)
+            break;
+
+        errno = 0;
+        value = strtol(p, &end, 0);
+        if (end == p || errno)
+            return -EINVAL;
+        if (count == max_values)
+            return -E2BIG;
+
+        values[count++] = (int)value;
+        p = end;
+    }
+
+    return count;
+}
+
+static int soc_listed(const char *list, int soc_id)
+{
+    int ids[BOOST_PROFILE_MAX_RESOURCES];
+    int i, count;
+
+    count = parse_values(list, ids, ARRAY_SIZE(ids));
+    for (i = 0; i < count; i++) {
+        if (ids[i] == soc_id)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Reads all <Boost> elements into 'entries' and records, for every
+ * [hint][governor] slot, the index of the most specific matching entry.
+ * Returns the number of entries or a negative errno.
+ */
+static int parse_profiles(xmlNodePtr root, int soc_id,
+        struct boost_profile_entry **entries_out,
+        int owner[BOOST_PROFILE_COUNT][GOVERNOR_TYPE_COUNT])
+{
+    int match[BOOST_PROFILE_COUNT][GOVERNOR_TYPE_COUNT];
+    struct boost_profile_entry *entries = NULL;
+    int num_entries = 0;
+    xmlNodePtr node;
+
+    memset(match, -1, sizeof(match));
+
+    for (node = root->children; node; node = node->next) {
+        struct boost_profile_entry *entry;
+        enum boost_profile_id id;
+        enum governor_type governor = GOVERNOR_UNKNOWN;
+        xmlChar *hint, *gov, *soc, *text;
+        int specificity = 0;
+        int skip = 0;
+        int g;
+
+        if (node->type != XML_ELEMENT_NODE ||
+                xmlStrcmp(node->name, (const xmlChar *)"Boost"))
+            continue;
+
+        hint = xmlGetProp(node, (const xmlChar *)"hint");
+        gov = xmlGetProp(node, (const xmlChar *)"governor");
+        soc = xmlGetProp(node, (const xmlChar *)"soc");
+
+        id = hint ? profile_from_name((const char *)hint) : BOOST_PROFILE_NONE;
+        if (id == BOOST_PROFILE_NONE) {
+            ALOGE("%s: line %d: unknown hint '%s'", __func__, node->line,
+                    hint ? (const char *)hint : "");
+            skip = 1;
+        }
+        if (gov) {
+            governor = governor_type_from_name((const char *)gov);
+            if (governor == GOVERNOR_OTHER) {
+                ALOGE("%s: line %d: unknown governor '%s'", __func__,
+                        node->line, (const char *)gov);
+                skip = 1;
+            }
+            specificity |= MATCH_GOVERNOR;
+        }
+        if (soc) {
+            if (!soc_listed((const char *)soc, soc_id))
+                skip = 1;
+            specificity |= MATCH_SOC;
+        }
+
+        xmlFree(hint);
+        xmlFree(gov);
+        xmlFree(soc);
+
+        if (skip)
+            continue;
+
+        entry = realloc(entries, (num_entries + 1) * sizeof(*entries));
+        if (!entry) {
+            free(entries);
+            return -ENOMEM;
+        }
+        entries = entry;
+        entry = &entries[num_entries];
+
+        text = xmlNodeGetContent(node);
+        entry->count = text ? parse_values((const char *)text, entry->values,
+                ARRAY_SIZE(entry->values)) : 0;
+        xmlFree(text);
+
+        if (entry->count <= 0) {
+            ALOGE("%s: line %d: invalid resource list", __func__, node->line);
+            continue;
+        }
+
+        for (g = GOVERNOR_UNKNOWN; g < GOVERNOR_TYPE_COUNT; g++) {
+            if ((specificity & MATCH_GOVERNOR) && g != (int)governor)
+                continue;
+            if (specificity < match[id][g])
+                continue;
+            match[id][g] = specificity;
+            owner[id][g] = num_entries;
+        }
+        num_entries++;
+    }
+
+    *entries_out = entries;
+    return num_entries;
+}
+
+int boost_profile_load(const char *path, int soc_id)
+{
+    int owner[BOOST_PROFILE_COUNT][GOVERNOR_TYPE_COUNT];
+    struct boost_profile_entry *entries = NULL;
+    size_t pool_size = 0;
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    int num_entries;
+    int *pool;
+    int i, g;
+
+    if (atomic_load(&profiles_loaded))
+        return -EALREADY;
+
+    if (access(path, R_OK))
+        return -errno;
+
+    doc = xmlReadFile(path, NULL, XML_PARSE_NONET);
+    if (!doc) {
+        ALOGE("%s: failed to parse %s", __func__, path);
+        return -EINVAL;
+    }
+
+    root = xmlDocGetRootElement(doc);
+    if (!root || xmlStrcmp(root->name, (const xmlChar *)"BoostProfiles")) {
+        ALOGE("%s: %s has no BoostProfiles element", __func__, path);
+        xmlFreeDoc(doc);
+        return -EINVAL;
+    }
+
+    memset(owner, -1, sizeof(owner));
+    num_entries = parse_profiles(root, soc_id, &entries, owner);
+    xmlFreeDoc(doc);
+    if (num_entries <= 0) {
+        free(entries);
+        return num_entries;
+    }
+
+    /* Pack only the entries that won a slot, each exactly once. */
+    for (i = 0; i < num_entries; i++)
+        entries[i].pool_offset = -1;
+    for (i = 0; i < BOOST_PROFILE_COUNT; i++) {
+        for (g = 0; g < GOVERNOR_TYPE_COUNT; g++) {
+            int e = owner[i][g];
+            if (e >= 0 && entries[e].pool_offset < 0) {
+                entries[e].pool_offset = pool_size;
+                pool_size += entries[e].count;
+            }
+        }
+    }
+
+    pool = malloc(pool_size * sizeof(int));
+    if (!pool) {
+        free(entries);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < BOOST_PROFILE_COUNT; i++) {
+        for (g = 0; g < GOVERNOR_TYPE_COUNT; g++) {
+            int e = owner[i][g];
+            if (e < 0)
+                continue;
+            memcpy(&pool[entries[e].pool_offset], entries[e].values,
+                    entries[e].count * sizeof(int));
+            profile_slots[i][g].offset = entries[e].pool_offset;
+            profile_slots[i][g].count = entries[e].count;
+            if (owner[i][g] != owner[i][0])
+                profile_per_governor[i] = true;
+        }
+    }
+    free(entries);
+
+    profile_pool = pool;
+    atomic_store(&profiles_loaded, true);
+
+    ALOGI("Loaded %zu boost resources for SoC %d from %s", pool_size, soc_id, path);
+
+    return 0;
+}
+
+bool boost_profile_loaded(void)
+{
+    return atomic_load_explicit(&profiles_loaded, memory_order_acquire);
+}
+
+/*
+ * Returns the loaded resource list for a hint under the given governor,
+ * or NULL if the device profile doesn't define one.
+ */
+int *boost_profile_get(enum boost_profile_id id, enum governor_type governor,
+        int *num_resources)
+{
+    const struct boost_profile_slot *slot;
+
+    if (!boost_profile_loaded())
+        return NULL;
+    if (id < 0 || id >= BOOST_PROFILE_COUNT ||
+            governor < 0 || governor >= GOVERNOR_TYPE_COUNT)
+        return NULL;
+
+    slot = &profile_slots[id][governor];
+    if (!slot->count)
+        return NULL;
+
+    *num_resources = slot->count;
+    return &profile_pool[slot->offset];
+}
+
+/*
+ * As boost_profile_get(), for the governor currently running on CPU0.
+ * The governor is only looked up when the profile depends on it.
+ */
+int *boost_profile_lookup(enum boost_profile_id id, int *num_resources)
+{
+    enum governor_type governor = GOVERNOR_UNKNOWN;
+
+    if (!boost_profile_loaded() || id < 0 || id >= BOOST_PROFILE_COUNT)
+        return NULL;
+
+    if (profile_per_governor[id])
+        governor = governor_cache_get(CPU0);
+
+    return boost_profile_get(id, governor, num_resources);
+}
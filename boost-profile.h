@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_BOOST_PROFILE_H
+#define _QCOM_POWER_BOOST_PROFILE_H
+
+#include <stdbool.h>
+
+#include "governor-cache.h"
+
+#ifndef BOOST_PROFILE_PATH
+#define BOOST_PROFILE_PATH "/vendor/etc/power_boost_profiles.xml"
+#endif
+
+enum boost_profile_id {
+    BOOST_PROFILE_NONE = -1,
+    BOOST_PROFILE_INTERACTION = 0,
+    BOOST_PROFILE_FLING,
+    BOOST_PROFILE_LAUNCH,
+    BOOST_PROFILE_VIDEO_ENCODE,
+    BOOST_PROFILE_VIDEO_DECODE,
+    BOOST_PROFILE_DISPLAY_OFF,
+    BOOST_PROFILE_COUNT,
+};
+
+int boost_profile_load(const char *path, int soc_id);
+bool boost_profile_loaded(void);
+int *boost_profile_get(enum boost_profile_id id, enum governor_type governor,
+        int *num_resources);
+int *boost_profile_lookup(enum boost_profile_id id, int *num_resources);
+
+#endif
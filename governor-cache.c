@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * In-memory view of the cpufreq governor of every CPU.
+ *
+ * Governors change rarely (init scripts, perfd, hotplug) while hints
+ * arrive at touch rate, so the governor of each CPU is read once and kept
+ * as an enum. The cache is invalidated by CPU hotplug uevents and, since
+ * the kernel doesn't notify writes to scaling_governor, refreshed at most
+ * once per GOVERNOR_CACHE_TTL_MS as a safety net.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <linux/netlink.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "governor-cache.h"
+#include "power-clock.h"
+#include "power-common.h"
+
+#define GOVERNOR_CACHE_TTL_MS 1000
+#define GOVERNOR_NAME_MAX 32
+#define UEVENT_MSG_LEN 2048
+/* Multicast group the kernel sends uevents to, as opposed to udev. */
+#define UEVENT_KERNEL_GROUP 1
+#define CPU_DEVPATH "/devices/system/cpu/"
+
+#define SCALING_GOVERNOR_FMT "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor"
+
+static const char *governor_names[] = {
+    [GOVERNOR_UNKNOWN] = "",
+    [GOVERNOR_INTERACTIVE] = INTERACTIVE_GOVERNOR,
+    [GOVERNOR_ONDEMAND] = ONDEMAND_GOVERNOR,
+    [GOVERNOR_SCHEDUTIL] = "schedutil",
+    [GOVERNOR_CONSERVATIVE] = "conservative",
+    [GOVERNOR_PERFORMANCE] = "performance",
+    [GOVERNOR_POWERSAVE] = "powersave",
+    [GOVERNOR_USERSPACE] = "userspace",
+    [GOVERNOR_OTHER] = "",
+};
+
+static atomic_int governor_types[GOVERNOR_CACHE_MAX_CPUS];
+/* Power clock ms after which the cache must be re-read; 0 = stale. */
+static atomic_llong governor_refresh_deadline;
+static pthread_mutex_t governor_refresh_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long now_ms(void)
+{
+    return power_clock_now_ns() / 1000000LL;
+}
+
+enum governor_type governor_type_from_name(const char *name)
+{
+    size_t i;
+
+    for (i = GOVERNOR_INTERACTIVE; i < GOVERNOR_OTHER; i++) {
+        if (!strcmp(name, governor_names[i]))
+            return i;
+    }
+
+    return GOVERNOR_OTHER;
+}
+
+static enum governor_type read_governor(int cpu)
+{
+    char path[PATH_MAX];
+    char name[GOVERNOR_NAME_MAX];
+    ssize_t len;
+    int fd;
+
+    snprintf(path, sizeof(path), SCALING_GOVERNOR_FMT, cpu);
+
+    /* Offline CPUs have no cpufreq node; that's expected, don't log. */
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return GOVERNOR_UNKNOWN;
+
+    len = read(fd, name, sizeof(name) - 1);
+    close(fd);
+    if (len <= 0)
+        return GOVERNOR_UNKNOWN;
+
+    name[len] = '\0';
+    while (len > 0 && (name[len - 1] == '\n' || name[len - 1] == '\r'))
+        name[--len] = '\0';
+
+    return governor_type_from_name(name);
+}
+
+static void governor_cache_refresh(void)
+{
+    int cpu;
+
+    pthread_mutex_lock(&governor_refresh_lock);
+
+    /* Another caller may have refreshed while we waited for the lock. */
+    if (now_ms() < atomic_load(&governor_refresh_deadline)) {
+        pthread_mutex_unlock(&governor_refresh_lock);
+        return;
+    }
+
+    for (cpu = 0; cpu < GOVERNOR_CACHE_MAX_CPUS; cpu++)
+        atomic_store(&governor_types[cpu], read_governor(cpu));
+
+    atomic_store(&governor_refresh_deadline, now_ms() + GOVERNOR_CACHE_TTL_MS);
+
+    pthread_mutex_unlock(&governor_refresh_lock);
+}
+
+void governor_cache_invalidate(void)
+{
+    atomic_store(&governor_refresh_deadline, 0);
+}
+
+enum governor_type governor_cache_get(int cpu)
+{
+    if (cpu < 0 || cpu >= GOVERNOR_CACHE_MAX_CPUS)
+        return GOVERNOR_UNKNOWN;
+
+    if (now_ms() >= atomic_load(&governor_refresh_deadline))
+        governor_cache_refresh();
+
+    return atomic_load(&governor_types[cpu]);
+}
+
+const char *governor_type_name(enum governor_type type)
+{
+    if (type > GOVERNOR_OTHER)
+        return "";
+
+    return governor_names[type];
+}
+
+/*
+ * Invalidates the cache whenever a CPU goes on- or offline, since the
+ * governor of a freshly onlined cluster may differ from the cached one.
+ */
+static void *governor_uevent_thread(void *arg)
+{
+    char msg[UEVENT_MSG_LEN + 2];
+    int fd = (int)(intptr_t)arg;
+
+    for (;;) {
+        ssize_t len = TEMP_FAILURE_RETRY(recv(fd, msg, UEVENT_MSG_LEN, 0));
+        const char *cp;
+
+        if (len <= 0)
+            break;
+
+        msg[len] = msg[len + 1] = '\0';
+
+        /*
+         * Message is an "action@devpath" header followed by a list of
+         * NUL-separated KEY=value strings. Most uevents are for other
+         * devices; the header is enough to drop those.
+         */
+        cp = strchr(msg, '@');
+        if (!cp || strncmp(cp + 1, CPU_DEVPATH, strlen(CPU_DEVPATH)))
+            continue;
+
+        for (cp = msg; cp < msg + len; cp += strlen(cp) + 1) {
+            if (!strcmp(cp, "SUBSYSTEM=cpu")) {
+                governor_cache_invalidate();
+                break;
+            }
+        }
+    }
+
+    ALOGE("governor uevent listener exited");
+    close(fd);
+
+    return NULL;
+}
+
+void governor_cache_init(void)
+{
+    struct sockaddr_nl addr;
+    pthread_t thread;
+    int fd;
+
+    governor_cache_invalidate();
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        ALOGW("Unable to open uevent socket: %s", strerror(errno));
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = UEVENT_KERNEL_GROUP;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ALOGW("Unable to bind uevent socket: %s", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    if (pthread_create(&thread, NULL, governor_uevent_thread,
+                (void *)(intptr_t)fd)) {
+        ALOGW("Unable to start governor uevent listener");
+        close(fd);
+        return;
+    }
+    pthread_detach(thread);
+}
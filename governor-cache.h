@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_GOVERNOR_CACHE_H
+#define _QCOM_POWER_GOVERNOR_CACHE_H
+
+#define GOVERNOR_CACHE_MAX_CPUS 8
+
+enum governor_type {
+    GOVERNOR_UNKNOWN = 0,   /* CPU offline or node unreadable */
+    GOVERNOR_INTERACTIVE,
+    GOVERNOR_ONDEMAND,
+    GOVERNOR_SCHEDUTIL,
+    GOVERNOR_CONSERVATIVE,
+    GOVERNOR_PERFORMANCE,
+    GOVERNOR_POWERSAVE,
+    GOVERNOR_USERSPACE,
+    GOVERNOR_OTHER,         /* Readable, but not one of the above */
+    GOVERNOR_TYPE_COUNT,
+};
+
+void governor_cache_init(void);
+void governor_cache_invalidate(void);
+enum governor_type governor_cache_get(int cpu);
+const char *governor_type_name(enum governor_type type);
+enum governor_type governor_type_from_name(const char *name);
+
+#endif
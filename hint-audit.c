@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <cutils/properties.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-audit.h"
+#include "hint-data.h"
+#include "hint-scheduler.h"
+#include "power-clock.h"
+#include "power-common.h"
+#include "utils.h"
+
+#define NSINMS 1000000LL
+
+/* Hint ids are grouped by their upper byte, as in hint-data.h. */
+#define HINT_CLASS_MASK 0xFF00
+
+struct hint_class {
+    const char *name;
+    unsigned long hint_id;      /* after HINT_CLASS_MASK */
+    long long budget_ns;        /* 0 if unlimited */
+    unsigned long held;
+    unsigned long expired;
+    long long total_ns;
+    long long max_ns;
+};
+
+static struct hint_class classes[] = {
+    { .name = "video_encode", .hint_id = DEFAULT_VIDEO_ENCODE_HINT_ID },
+    { .name = "video_decode", .hint_id = DEFAULT_VIDEO_DECODE_HINT_ID },
+    { .name = "display", .hint_id = DISPLAY_STATE_HINT_ID },
+    { .name = "display_2", .hint_id = DISPLAY_STATE_HINT_ID_2 },
+    { .name = "cam_preview", .hint_id = CAM_PREVIEW_HINT_ID },
+    { .name = "sustained", .hint_id = SUSTAINED_PERF_HINT_ID },
+    { .name = "vr", .hint_id = VR_MODE_HINT_ID },
+    /* Everything else, e.g. ids from video metadata. Must be last. */
+    { .name = "other" },
+};
+
+static pthread_mutex_t audit_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t audit_once = PTHREAD_ONCE_INIT;
+/* Deadline the newest audit job was armed for, 0 if none. */
+static long long armed_ns;
+static unsigned int armed_gen;
+static unsigned int armed_job = HINT_SCHED_INVALID;
+
+static void load_budgets(void)
+{
+    char prop[64];
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(classes); i++) {
+        int budget_ms;
+
+        snprintf(prop, sizeof(prop), HINT_AUDIT_BUDGET_PROP "%s", classes[i].name);
+        budget_ms = property_get_int32(prop, 0);
+        if (budget_ms > 0) {
+            classes[i].budget_ns = budget_ms * NSINMS;
+            ALOGI("Expiring %s hint locks after %d ms", classes[i].name, budget_ms);
+        }
+    }
+}
+
+static struct hint_class *hint_class(unsigned long hint_id)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(classes) - 1; i++) {
+        if (classes[i].hint_id == (hint_id & HINT_CLASS_MASK))
+            return &classes[i];
+    }
+
+    return &classes[ARRAY_SIZE(classes) - 1];
+}
+
+static void audit(void *arg);
+
+/*
+ * Arms an audit job for 'deadline_ns' unless one is due sooner. Returns
+ * the job this supersedes, for the caller to cancel once audit_lock is
+ * dropped, or HINT_SCHED_INVALID.
+ */
+static unsigned int arm_locked(long long deadline_ns)
+{
+    unsigned int job, superseded;
+    long long delay_ms;
+
+    if (armed_ns && armed_ns <= deadline_ns)
+        return HINT_SCHED_INVALID;
+
+    /* Round up, so the job never runs before the lock is overdue. */
+    delay_ms = (deadline_ns - power_clock_now_ns() + NSINMS - 1) / NSINMS;
+    if (delay_ms < 0)
+        delay_ms = 0;
+
+    /* On failure the job already armed, if any, stays in charge. */
+    job = hint_schedule_call(delay_ms, audit, (void *)(uintptr_t)(armed_gen + 1));
+    if (job == HINT_SCHED_INVALID) {
+        ALOGE("Unable to schedule the hint lock audit");
+        return HINT_SCHED_INVALID;
+    }
+
+    armed_gen++;
+    superseded = armed_job;
+    armed_job = job;
+    armed_ns = deadline_ns;
+
+    return superseded;
+}
+
+/*
+ * Releases every budgeted lock that is overdue, then re-arms for the
+ * next deadline. A job superseded by an earlier one only does the
+ * former.
+ */
+static void audit(void *arg)
+{
+    struct hint_data hints[HINT_TABLE_SIZE];
+    unsigned int count, i;
+    long long now, next_ns = 0;
+
+    count = get_active_hints(hints, HINT_TABLE_SIZE);
+    now = power_clock_now_ns();
+
+    for (i = 0; i < count; i++) {
+        const struct hint_class *class = hint_class(hints[i].hint_id);
+        long long deadline_ns = hints[i].since_ns + class->budget_ns;
+
+        if (!class->budget_ns)
+            continue;
+
+        if (deadline_ns <= now) {
+            ALOGW("Hint 0x%lx (%s) held %lld ms, over its %lld ms budget; releasing",
+                    hints[i].hint_id, class->name,
+                    (now - hints[i].since_ns) / NSINMS, class->budget_ns / NSINMS);
+            expire_hint_action(hints[i].hint_id, hints[i].since_ns);
+        } else if (!next_ns || deadline_ns < next_ns) {
+            next_ns = deadline_ns;
+        }
+    }
+
+    pthread_mutex_lock(&audit_lock);
+    if ((uintptr_t)arg == armed_gen) {
+        armed_ns = 0;
+        armed_job = HINT_SCHED_INVALID;
+        if (next_ns)
+            arm_locked(next_ns);
+    }
+    pthread_mutex_unlock(&audit_lock);
+}
+
+void hint_audit_acquired(unsigned long hint_id, long long since_ns)
+{
+    const struct hint_class *class;
+    unsigned int superseded;
+
+    pthread_once(&audit_once, load_budgets);
+    class = hint_class(hint_id);
+    if (!class->budget_ns)
+        return;
+
+    pthread_mutex_lock(&audit_lock);
+    superseded = arm_locked(since_ns + class->budget_ns);
+    pthread_mutex_unlock(&audit_lock);
+
+    /* Unlocked: a running audit job finishes first, and it takes audit_lock. */
+    if (superseded != HINT_SCHED_INVALID)
+        hint_schedule_cancel(superseded);
+}
+
+void hint_audit_released(unsigned long hint_id, long long since_ns, bool expired)
+{
+    struct hint_class *class = hint_class(hint_id);
+    long long held_ns = power_clock_now_ns() - since_ns;
+
+    ALOGI("Hint 0x%lx (%s) released after %lld ms", hint_id, class->name,
+            held_ns / NSINMS);
+
+    pthread_mutex_lock(&audit_lock);
+    class->held++;
+    class->total_ns += held_ns;
+    if (held_ns > class->max_ns)
+        class->max_ns = held_ns;
+    if (expired)
+        class->expired++;
+    pthread_mutex_unlock(&audit_lock);
+}
+
+void hint_audit_dump(int fd)
+{
+    unsigned int i;
+
+    pthread_once(&audit_once, load_budgets);
+    pthread_mutex_lock(&audit_lock);
+
+    dprintf(fd, "\nIndefinite hint locks:\n");
+    dprintf(fd, "  %-14s %10s %8s %8s %12s %12s\n", "class", "budget(ms)",
+            "held", "expired", "mean(ms)", "max(ms)");
+    for (i = 0; i < ARRAY_SIZE(classes); i++) {
+        const struct hint_class *class = &classes[i];
+
+        if (!class->held && !class->budget_ns)
+            continue;
+
+        dprintf(fd, "  %-14s %10lld %8lu %8lu %12lld %12lld\n", class->name,
+                class->budget_ns / NSINMS, class->held, class->expired,
+                class->held ? class->total_ns / class->held / NSINMS : 0,
+                class->max_ns / NSINMS);
+    }
+
+    pthread_mutex_unlock(&audit_lock);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_HINT_AUDIT_H
+#define _QCOM_POWER_HINT_AUDIT_H
+
+#include <stdbool.h>
+
+/*
+ * Maximum lifetime in ms of an indefinite hint lock, per hint class,
+ * e.g. vendor.power.hint_budget.video_decode=600000. Unset or 0 means
+ * the class is never expired.
+ */
+#define HINT_AUDIT_BUDGET_PROP "vendor.power.hint_budget."
+
+/*
+ * Bookkeeping for the locks perform_hint_action() holds until a
+ * matching undo. Each one is timed; a lock outliving its class budget
+ * is logged and released by an audit job on the hint scheduler, armed
+ * only for the earliest pending deadline, so nothing runs while no
+ * budgeted lock is held.
+ */
+void hint_audit_acquired(unsigned long hint_id, long long since_ns);
+void hint_audit_released(unsigned long hint_id, long long since_ns, bool expired);
+
+void hint_audit_dump(int fd);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Attributes long-lived locks to the process that asked for them, and
+ * releases them once that process is gone.
+ *
+ * IPower hands us no binder object of the caller's to link to, so death
+ * is noticed by polling instead: while anything is attributed, a
+ * scheduler job checks every HINT_CLIENT_POLL_MS that each owner still
+ * exists with the start time it had when the lock was taken, which also
+ * catches a recycled pid.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-client.h"
+#include "hint-scheduler.h"
+#include "power-clock.h"
+
+#define NSINSEC 1000000000LL
+
+/* starttime is the 22nd field of /proc/<pid>/stat; 20 after the name. */
+#define STAT_STARTTIME_FIELD 20
+
+struct client_lock {
+    void *owner;                /* NULL while free */
+    unsigned long id;
+    const char *kind;
+    hint_client_release_fn release;
+    struct hint_client_holder holder;
+    long long since_ns;
+};
+
+static struct client_lock locks[HINT_CLIENT_MAX_LOCKS];
+static int num_locks;
+static bool poll_pending;
+static pthread_mutex_t client_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct hint_client current_client;
+
+void hint_client_enter(struct hint_client client)
+{
+    current_client = client;
+}
+
+void hint_client_leave(void)
+{
+    current_client.pid = 0;
+    current_client.uid = 0;
+}
+
+struct hint_client hint_client_current(void)
+{
+    return current_client;
+}
+
+unsigned long long hint_client_start_time(int pid)
+{
+    char path[32], buf[512];
+    char *p, *save;
+    ssize_t len;
+    int fd, i;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    /* The name may hold spaces and parentheses; skip past the last ')'. */
+    p = strrchr(buf, ')');
+    if (!p)
+        return 0;
+
+    p = strtok_r(p + 1, " ", &save);
+    for (i = 1; p && i < STAT_STARTTIME_FIELD; i++)
+        p = strtok_r(NULL, " ", &save);
+
+    return p ? strtoull(p, NULL, 10) : 0;
+}
+
+static struct client_lock *find_lock(void *owner, unsigned long id)
+{
+    int i;
+
+    for (i = 0; i < HINT_CLIENT_MAX_LOCKS; i++) {
+        if (locks[i].owner == owner && locks[i].id == id)
+            return &locks[i];
+    }
+
+    return NULL;
+}
+
+static struct client_lock *alloc_lock(void *owner, unsigned long id)
+{
+    int i;
+
+    for (i = 0; i < HINT_CLIENT_MAX_LOCKS; i++) {
+        if (!locks[i].owner) {
+            locks[i].owner = owner;
+            locks[i].id = id;
+            num_locks++;
+            return &locks[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void free_lock(struct client_lock *lock)
+{
+    lock->owner = NULL;
+    num_locks--;
+}
+
+static void poll_clients(void *arg);
+
+/* Called with client_lock held. */
+static void schedule_poll(void)
+{
+    if (poll_pending || !num_locks)
+        return;
+
+    poll_pending = hint_schedule_call(HINT_CLIENT_POLL_MS, poll_clients, NULL) !=
+            HINT_SCHED_INVALID;
+    if (!poll_pending)
+        ALOGE("Unable to watch hint clients");
+}
+
+static void poll_clients(void *arg)
+{
+    struct client_lock dead[HINT_CLIENT_MAX_LOCKS];
+    int num_dead = 0;
+    int i, j;
+
+    (void)arg;
+
+    pthread_mutex_lock(&client_lock);
+    poll_pending = false;
+
+    for (i = 0; i < HINT_CLIENT_MAX_LOCKS; i++) {
+        struct client_lock *lock = &locks[i];
+        bool checked = false;
+
+        if (!lock->owner)
+            continue;
+
+        /* A pid already found dead needs no second look. */
+        for (j = 0; j < num_dead; j++) {
+            if (hint_client_same_holder(dead[j].holder, lock->holder)) {
+                checked = true;
+                break;
+            }
+        }
+
+        if (checked || hint_client_start_time(lock->holder.client.pid) !=
+                lock->holder.start_time) {
+            dead[num_dead++] = *lock;
+            free_lock(lock);
+        }
+    }
+
+    schedule_poll();
+    pthread_mutex_unlock(&client_lock);
+
+    /* Released unlocked, as the release paths untrack. */
+    for (i = 0; i < num_dead; i++) {
+        ALOGW("Client pid %d uid %d died, releasing %s 0x%lx",
+                dead[i].holder.client.pid, dead[i].holder.client.uid,
+                dead[i].kind, dead[i].id);
+        dead[i].release(dead[i].owner, dead[i].id, dead[i].holder);
+    }
+}
+
+struct hint_client_holder hint_client_current_holder(void)
+{
+    struct hint_client_holder holder = { current_client, 0 };
+
+    /* Never attribute our own calls, whatever thread they come from. */
+    if (holder.client.pid == getpid())
+        holder.client.pid = 0;
+    if (holder.client.pid)
+        holder.start_time = hint_client_start_time(holder.client.pid);
+
+    return holder;
+}
+
+void hint_client_track(void *owner, unsigned long id,
+        struct hint_client_holder holder, const char *kind,
+        hint_client_release_fn release)
+{
+    struct client_lock *lock;
+
+    pthread_mutex_lock(&client_lock);
+
+    lock = find_lock(owner, id);
+    if (!holder.start_time) {
+        /* Unknown or already gone: nobody to clean up after. */
+        if (lock)
+            free_lock(lock);
+        pthread_mutex_unlock(&client_lock);
+        return;
+    }
+
+    if (!lock && !(lock = alloc_lock(owner, id))) {
+        pthread_mutex_unlock(&client_lock);
+        ALOGE("Too many client locks, not tracking %s 0x%lx", kind, id);
+        return;
+    }
+
+    lock->kind = kind;
+    lock->release = release;
+    lock->holder = holder;
+    lock->since_ns = power_clock_now_ns();
+    schedule_poll();
+
+    pthread_mutex_unlock(&client_lock);
+}
+
+void hint_client_untrack(void *owner, unsigned long id)
+{
+    struct client_lock *lock;
+
+    pthread_mutex_lock(&client_lock);
+    lock = find_lock(owner, id);
+    if (lock)
+        free_lock(lock);
+    pthread_mutex_unlock(&client_lock);
+}
+
+void hint_client_dump(int fd)
+{
+    bool shown[HINT_CLIENT_MAX_LOCKS] = { false };
+    long long now;
+    int i, j;
+
+    pthread_mutex_lock(&client_lock);
+    now = power_clock_now_ns();
+
+    dprintf(fd, "\n%d client lock(s)\n", num_locks);
+    for (i = 0; i < HINT_CLIENT_MAX_LOCKS; i++) {
+        if (!locks[i].owner || shown[i])
+            continue;
+
+        dprintf(fd, "  pid %d uid %d\n", locks[i].holder.client.pid,
+                locks[i].holder.client.uid);
+        for (j = i; j < HINT_CLIENT_MAX_LOCKS; j++) {
+            const struct client_lock *lock = &locks[j];
+
+            if (!lock->owner ||
+                    !hint_client_same_holder(lock->holder, locks[i].holder))
+                continue;
+
+            dprintf(fd, "      %s 0x%lx, held %llds\n", lock->kind, lock->id,
+                    (now - lock->since_ns) / NSINSEC);
+            shown[j] = true;
+        }
+    }
+
+    pthread_mutex_unlock(&client_lock);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_HINT_CLIENT_H
+#define _QCOM_POWER_HINT_CLIENT_H
+
+#include <stdbool.h>
+
+/* Number of long-lived locks that can be attributed at once. */
+#define HINT_CLIENT_MAX_LOCKS 32
+/* How often clients holding locks are checked for liveness. */
+#define HINT_CLIENT_POLL_MS 5000
+
+/* The process a hint is being handled for. pid 0 means unknown. */
+struct hint_client {
+    int pid;
+    int uid;
+};
+
+/*
+ * A client process, told apart from a later one that reuses its pid.
+ * start_time is 0 when there is no client to hold anything.
+ */
+struct hint_client_holder {
+    struct hint_client client;
+    unsigned long long start_time;
+};
+
+/*
+ * Releases the lock identified by (owner, id) if 'dead' still holds it.
+ * Called from the scheduler thread once that client has died; someone
+ * else may have asked for the same lock since.
+ */
+typedef void (*hint_client_release_fn)(void *owner, unsigned long id,
+        struct hint_client_holder dead);
+
+/*
+ * Sets the client the calling thread is handling hints for, until
+ * hint_client_leave(). Locks tracked in between are attributed to it.
+ */
+void hint_client_enter(struct hint_client client);
+void hint_client_leave(void);
+struct hint_client hint_client_current(void);
+
+/* Start time of 'pid' in clock ticks, or 0 if it is gone. */
+unsigned long long hint_client_start_time(int pid);
+
+/* The current client as a holder. Our own calls have none. */
+struct hint_client_holder hint_client_current_holder(void);
+
+static inline bool hint_client_same_holder(struct hint_client_holder a,
+        struct hint_client_holder b)
+{
+    return a.client.pid == b.client.pid && a.start_time == b.start_time;
+}
+
+/*
+ * Attributes the lock identified by (owner, id) to 'holder', replacing
+ * any previous one. With no holder, any previous attribution is dropped
+ * and the lock is left alone from then on.
+ */
+void hint_client_track(void *owner, unsigned long id,
+        struct hint_client_holder holder, const char *kind,
+        hint_client_release_fn release);
+void hint_client_untrack(void *owner, unsigned long id);
+
+/* Writes the attributed locks, grouped by client, to 'fd'. */
+void hint_client_dump(int fd);
+
+#endif
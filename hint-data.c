@@ -27,20 +27,123 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
 #include <log/log.h>
 
 #include "hint-data.h"
 
-int hint_compare(struct hint_data *first_hint,
-        struct hint_data *other_hint) {
-    if (first_hint == other_hint) {
-        return 0;
-    } else if ((first_hint && other_hint) &&
-            (first_hint->hint_id == other_hint->hint_id)) {
-        return 0;
-    } else {
+#define HINT_TABLE_MASK (HINT_TABLE_SIZE - 1)
+
+static inline unsigned int hint_hash(unsigned long hint_id)
+{
+    /* Fibonacci hashing; hint IDs are clustered multiples of 0x100. */
+    return (((unsigned int)hint_id * 2654435761u) >> 16) & HINT_TABLE_MASK;
+}
+
+static int hint_table_lookup(const struct hint_table *table,
+        unsigned long hint_id)
+{
+    unsigned int idx = hint_hash(hint_id);
+    unsigned int i;
+
+    for (i = 0; i < HINT_TABLE_SIZE && table->used[idx];
+            i++, idx = (idx + 1) & HINT_TABLE_MASK) {
+        if (table->slots[idx].hint_id == hint_id)
+            return idx;
+    }
+
+    return -1;
+}
+
+/*
+ * Stores 'hint'. If an entry with the same hint_id was already present
+ * it is overwritten, copied to 'replaced' (if non-NULL) and 1 is
+ * returned. Returns 0 on a fresh insert and -ENOSPC if the table is full.
+ */
+int hint_table_insert(struct hint_table *table, const struct hint_data *hint,
+        struct hint_data *replaced)
+{
+    unsigned int idx;
+    int found = hint_table_lookup(table, hint->hint_id);
+
+    if (found >= 0) {
+        if (replaced)
+            *replaced = table->slots[found];
+        table->slots[found] = *hint;
         return 1;
     }
+
+    /* Keep one slot empty so probe sequences always terminate. */
+    if (table->count >= HINT_TABLE_SIZE - 1)
+        return -ENOSPC;
+
+    for (idx = hint_hash(hint->hint_id); table->used[idx];
+            idx = (idx + 1) & HINT_TABLE_MASK)
+        ;
+
+    table->slots[idx] = *hint;
+    table->used[idx] = 1;
+    table->count++;
+
+    return 0;
+}
+
+struct hint_data *hint_table_find(struct hint_table *table,
+        unsigned long hint_id)
+{
+    int idx = hint_table_lookup(table, hint_id);
+
+    return idx >= 0 ? &table->slots[idx] : NULL;
+}
+
+/*
+ * Removes the entry for 'hint_id', copying it to 'removed' if non-NULL.
+ * Uses backward-shift deletion, so no tombstones accumulate.
+ */
+int hint_table_remove(struct hint_table *table, unsigned long hint_id,
+        struct hint_data *removed)
+{
+    int found = hint_table_lookup(table, hint_id);
+    unsigned int hole, idx;
+
+    if (found < 0)
+        return -ENOENT;
+
+    if (removed)
+        *removed = table->slots[found];
+
+    hole = found;
+    idx = (hole + 1) & HINT_TABLE_MASK;
+    while (table->used[idx]) {
+        unsigned int home = hint_hash(table->slots[idx].hint_id);
+
+        /* Move the entry back if its home isn't in (hole, idx]. */
+        if (((idx - home) & HINT_TABLE_MASK) >=
+                ((idx - hole) & HINT_TABLE_MASK)) {
+            table->slots[hole] = table->slots[idx];
+            hole = idx;
+        }
+        idx = (idx + 1) & HINT_TABLE_MASK;
+    }
+
+    table->used[hole] = 0;
+    table->count--;
+
+    return 0;
+}
+
+/* Copies up to 'max_hints' active entries out, for debugging. */
+unsigned int hint_table_copy(const struct hint_table *table,
+        struct hint_data *hints, unsigned int max_hints)
+{
+    unsigned int i, n = 0;
+
+    for (i = 0; i < HINT_TABLE_SIZE && n < max_hints; i++) {
+        if (table->used[i])
+            hints[n++] = table->slots[i];
+    }
+
+    return n;
 }
 
 void hint_dump(struct hint_data *hint)
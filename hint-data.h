@@ -28,6 +28,8 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "hint-client.h"
+
 /* Default use-case hint IDs */
 #define DEFAULT_VIDEO_ENCODE_HINT_ID    (0x0A00)
 #define DEFAULT_VIDEO_DECODE_HINT_ID    (0x0B00)
@@ -54,11 +56,38 @@
 
 #define DEFAULT_PROFILE_HINT_ID         (0xFF00)
 
+/* Number of hints that can be active at once. Must be a power of two. */
+#define HINT_TABLE_SIZE                 (64)
+
+/* Longest resource list a hint remembers; longer ones aren't kept. */
+#define HINT_MAX_RESOURCES              (32)
+
 struct hint_data {
     unsigned long hint_id; /* This is our key. */
     unsigned long perflock_handle;
+    int resources[HINT_MAX_RESOURCES]; /* The resource list held. */
+    int num_resources;            /* -1 if the list didn't fit */
+    struct hint_client_holder holder; /* who asked for it last */
+    long long since_ns;           /* power clock, when last requested */
+};
+
+/*
+ * Open-addressing table of active hints, keyed by hint_id. Slots are
+ * preallocated, so insert/find/remove never allocate and run in
+ * constant expected time.
+ */
+struct hint_table {
+    struct hint_data slots[HINT_TABLE_SIZE];
+    unsigned char used[HINT_TABLE_SIZE];
+    unsigned int count;
 };
 
-int hint_compare(struct hint_data *first_hint,
-        struct hint_data *other_hint);
+int hint_table_insert(struct hint_table *table, const struct hint_data *hint,
+        struct hint_data *replaced);
+struct hint_data *hint_table_find(struct hint_table *table,
+        unsigned long hint_id);
+int hint_table_remove(struct hint_table *table, unsigned long hint_id,
+        struct hint_data *removed);
+unsigned int hint_table_copy(const struct hint_table *table,
+        struct hint_data *hints, unsigned int max_hints);
 void hint_dump(struct hint_data *hint);
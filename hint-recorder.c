@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NO_HINT_RECORDER
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <hardware/power.h>
+
+#include "hint-recorder.h"
+#include "power-clock.h"
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+struct hint_record_header *hint_recorder_log;
+static struct hint_record *records;
+
+static size_t log_size(uint32_t capacity)
+{
+    return sizeof(struct hint_record_header) +
+            (size_t)capacity * sizeof(struct hint_record);
+}
+
+static bool log_compatible(const struct hint_record_header *header,
+        uint32_t capacity)
+{
+    return header->magic == HINT_RECORD_MAGIC &&
+            header->version == HINT_RECORD_VERSION &&
+            header->record_size == sizeof(struct hint_record) &&
+            header->capacity == capacity;
+}
+
+/*
+ * Called once from power_init(), before any hint can run. The mapping
+ * stays in place for the life of the process.
+ */
+void hint_recorder_init(void)
+{
+    char path[PROPERTY_VALUE_MAX];
+    struct hint_record_header *header;
+    struct stat st;
+    uint32_t capacity;
+    size_t size;
+    int fd, ret;
+
+    if (hint_recorder_log || property_get(HINT_RECORDER_PROP, path, "") <= 0)
+        return;
+
+    capacity = property_get_int32(HINT_RECORDER_ENTRIES_PROP,
+            HINT_RECORDER_DEFAULT_ENTRIES);
+    if (capacity < HINT_RECORDER_MIN_ENTRIES)
+        capacity = HINT_RECORDER_MIN_ENTRIES;
+    if (capacity > HINT_RECORDER_MAX_ENTRIES)
+        capacity = HINT_RECORDER_MAX_ENTRIES;
+    size = log_size(capacity);
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ALOGE("Unable to open %s: %s", path, strerror(errno));
+        return;
+    }
+
+    if (fstat(fd, &st)) {
+        ALOGE("Unable to stat %s: %s", path, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    /* Reserve the blocks up front so a store can never fault on ENOSPC. */
+    ret = posix_fallocate(fd, 0, size);
+    if (ret) {
+        ALOGE("Unable to size %s: %s", path, strerror(ret));
+        close(fd);
+        return;
+    }
+
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        ALOGE("Unable to map %s: %s", path, strerror(errno));
+        return;
+    }
+
+    if ((size_t)st.st_size != size || !log_compatible(header, capacity)) {
+        /* Fresh log. Touching every page now keeps faults off the hint path. */
+        memset(header, 0, size);
+        header->magic = HINT_RECORD_MAGIC;
+        header->version = HINT_RECORD_VERSION;
+        header->record_size = sizeof(struct hint_record);
+        header->capacity = capacity;
+    }
+
+    records = (struct hint_record *)(header + 1);
+    hint_recorder_log = header;
+    ALOGI("Recording hints to %s (%u entries)", path, capacity);
+}
+
+/* Claims the next slot and fills in everything but the payload. */
+static struct hint_record *record_begin(enum hint_record_type type, int code,
+        uint64_t *seq)
+{
+    struct hint_record *record;
+    long long now = power_clock_now_ns();
+    uint64_t index;
+
+    index = __atomic_fetch_add(&hint_recorder_log->head, 1, __ATOMIC_RELAXED);
+    record = &records[index % hint_recorder_log->capacity];
+
+    /* Invalidate the slot while it is rewritten. */
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    record->timestamp_ns = now;
+    record->type = type;
+    record->flags = 0;
+    record->meta_len = 0;
+    record->code = code;
+    record->value = 0;
+    *seq = index + 1;
+
+    return record;
+}
+
+static void record_commit(struct hint_record *record, uint64_t seq)
+{
+    __atomic_store_n(&record->seq, seq, __ATOMIC_RELEASE);
+}
+
+void hint_recorder_power_hint(int hint, void *data)
+{
+    struct hint_record *record;
+    uint64_t seq;
+
+    record = record_begin(HINT_RECORD_POWER_HINT, hint, &seq);
+
+    if (!data) {
+        record->flags |= HINT_RECORD_NULL_DATA;
+    } else if (hint == POWER_HINT_VIDEO_ENCODE || hint == POWER_HINT_VIDEO_DECODE) {
+        /* Same reading of 'data' as process_video_*_hint(). */
+        size_t len = strnlen(data, HINT_RECORD_META_SIZE);
+
+        if (len == HINT_RECORD_META_SIZE)
+            record->flags |= HINT_RECORD_META_TRUNCATED;
+        memcpy(record->meta, data, len);
+        record->meta_len = len;
+    } else {
+        record->value = *(int *)data;
+    }
+
+    record_commit(record, seq);
+}
+
+void hint_recorder_call(enum hint_record_type type, int code, int value)
+{
+    struct hint_record *record;
+    uint64_t seq;
+
+    record = record_begin(type, code, &seq);
+    record->value = value;
+    record_commit(record, seq);
+}
+
+#endif
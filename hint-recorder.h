@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_HINT_RECORDER_H
+#define _QCOM_POWER_HINT_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HINT_RECORDER_PROP "vendor.power.record"
+#define HINT_RECORDER_ENTRIES_PROP "vendor.power.record_entries"
+#define HINT_RECORDER_DEFAULT_ENTRIES 16384
+#define HINT_RECORDER_MIN_ENTRIES 64
+#define HINT_RECORDER_MAX_ENTRIES (1 << 20)
+
+/*
+ * Log file layout: one header followed by 'capacity' fixed-size
+ * records used as a ring. 'head' counts every record ever written;
+ * record i lives in slot i % capacity and is valid once its 'seq' reads
+ * i + 1, so a reader can skip slots that were being overwritten.
+ */
+#define HINT_RECORD_MAGIC 0x43455250u   /* "PREC" */
+#define HINT_RECORD_VERSION 1
+#define HINT_RECORD_META_SIZE 36
+
+enum hint_record_type {
+    HINT_RECORD_POWER_HINT = 1,
+    HINT_RECORD_SET_INTERACTIVE,
+    HINT_RECORD_SET_FEATURE,
+};
+
+/* power_hint() got NULL data. */
+#define HINT_RECORD_NULL_DATA 0x1
+/* The metadata string did not fit and was cut. */
+#define HINT_RECORD_META_TRUNCATED 0x2
+
+struct hint_record_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t head;
+    uint64_t reserved[5];
+};
+
+struct hint_record {
+    uint64_t seq;
+    uint64_t timestamp_ns;      /* power clock */
+    uint8_t type;
+    uint8_t flags;
+    uint16_t meta_len;          /* 0 unless a video hint */
+    uint32_t code;              /* hint or feature */
+    int32_t value;              /* hint data, on/off or feature state */
+    char meta[HINT_RECORD_META_SIZE];
+};
+
+/*
+ * Opt-in recorder for the HAL entry points, enabled by pointing
+ * HINT_RECORDER_PROP at a file. The file is sized and mapped once in
+ * power_init(); recording a call is a clock read and a store into the
+ * mapping, with no allocation or syscall. A compatible existing log is
+ * appended to. Recording is compiled out with NO_HINT_RECORDER.
+ */
+#ifdef NO_HINT_RECORDER
+
+#define hint_recorder_init() do { } while (0)
+#define HINT_RECORDER_POWER_HINT(hint, data) do { } while (0)
+#define HINT_RECORDER_CALL(type, code, value) do { } while (0)
+
+#else
+
+/* The mapped log; NULL while recording is off. */
+extern struct hint_record_header *hint_recorder_log;
+
+void hint_recorder_init(void);
+void hint_recorder_power_hint(int hint, void *data);
+void hint_recorder_call(enum hint_record_type type, int code, int value);
+
+static inline bool hint_recorder_enabled(void)
+{
+    return __builtin_expect(hint_recorder_log != NULL, 0);
+}
+
+#define HINT_RECORDER_POWER_HINT(hint, data) \
+    do { if (hint_recorder_enabled()) hint_recorder_power_hint(hint, data); } while (0)
+#define HINT_RECORDER_CALL(type, code, value) \
+    do { if (hint_recorder_enabled()) hint_recorder_call(type, code, value); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs delayed hint actions from a single thread.
+ *
+ * Pending jobs sit in a min-heap ordered by deadline. The thread sleeps
+ * in epoll_wait() on a timerfd that is always armed for the earliest
+ * deadline, so scheduling a job costs no thread and no allocation.
+ *
+ * Deadlines are on the power clock. When that clock is simulated the
+ * thread is never started and jobs run from power_clock_advance_to()
+ * instead, on the thread stepping the clock.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-client.h"
+#include "hint-scheduler.h"
+#include "power-clock.h"
+#include "utils.h"
+
+#define NSINUS 1000LL
+#define NSINMS 1000000LL
+#define NSINSEC 1000000000LL
+
+struct hint_job_phase {
+    long long delay_ns;
+    enum hint_phase_action action;
+    int hint_id;
+    int resources[HINT_SCHED_MAX_RESOURCES];
+    int num_resources;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+struct hint_job {
+    unsigned int id;            /* HINT_SCHED_INVALID while free */
+    long long deadline_ns;
+    int heap_index;             /* -1 while not queued */
+    int phase;
+    int num_phases;
+    bool ran;                   /* at least one phase has run */
+    bool cancelled;
+    struct hint_client client;  /* who scheduled it */
+    struct hint_job_phase phases[HINT_SCHED_MAX_PHASES];
+};
+
+static struct hint_job jobs[HINT_SCHED_MAX_JOBS];
+static struct hint_job *heap[HINT_SCHED_MAX_JOBS];
+static int heap_size;
+static unsigned int next_job_id = 1;
+static struct hint_job *running_job;
+static pthread_t running_thread;
+
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t sched_once = PTHREAD_ONCE_INIT;
+static pthread_t sched_thread;
+static int timer_fd = -1;
+static int epoll_fd = -1;
+
+static void heap_swap(int a, int b)
+{
+    struct hint_job *tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    heap[a]->heap_index = a;
+    heap[b]->heap_index = b;
+}
+
+static void heap_sift_up(int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+
+        if (heap[parent]->deadline_ns <= heap[i]->deadline_ns)
+            break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(int i)
+{
+    for (;;) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+
+        if (left < heap_size && heap[left]->deadline_ns < heap[smallest]->deadline_ns)
+            smallest = left;
+        if (right < heap_size && heap[right]->deadline_ns < heap[smallest]->deadline_ns)
+            smallest = right;
+        if (smallest == i)
+            break;
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+static void heap_push(struct hint_job *job)
+{
+    job->heap_index = heap_size;
+    heap[heap_size++] = job;
+    heap_sift_up(job->heap_index);
+}
+
+static void heap_remove(struct hint_job *job)
+{
+    int i = job->heap_index;
+
+    heap_size--;
+    if (i != heap_size) {
+        heap[i] = heap[heap_size];
+        heap[i]->heap_index = i;
+        heap_sift_up(i);
+        heap_sift_down(heap[i]->heap_index);
+    }
+    job->heap_index = -1;
+}
+
+/* Arms the timer for the earliest deadline, or disarms it. */
+static void arm_timer(void)
+{
+    struct itimerspec spec;
+
+    if (timer_fd < 0)
+        return;
+
+    memset(&spec, 0, sizeof(spec));
+    if (heap_size) {
+        long long deadline = heap[0]->deadline_ns;
+
+        /* A zero it_value would disarm the timer. */
+        if (deadline <= 0)
+            deadline = 1;
+        spec.it_value.tv_sec = deadline / NSINSEC;
+        spec.it_value.tv_nsec = deadline % NSINSEC;
+    }
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL))
+        ALOGE("%s: timerfd_settime failed: %s", __func__, strerror(errno));
+}
+
+static void run_phase(const struct hint_job_phase *phase)
+{
+    switch (phase->action) {
+        case HINT_PHASE_PERFORM:
+            perform_hint_action(phase->hint_id, (int *)phase->resources,
+                    phase->num_resources);
+            break;
+        case HINT_PHASE_UNDO:
+            undo_hint_action(phase->hint_id);
+            break;
+        case HINT_PHASE_CALL:
+            phase->fn(phase->arg);
+            break;
+    }
+}
+
+static void free_job(struct hint_job *job)
+{
+    job->id = HINT_SCHED_INVALID;
+}
+
+/* Runs every phase that is due. Called with sched_lock held. */
+static void run_due_jobs(void)
+{
+    while (heap_size && heap[0]->deadline_ns <= power_clock_now_ns()) {
+        struct hint_job *job = heap[0];
+
+        heap_remove(job);
+        running_job = job;
+        running_thread = pthread_self();
+        pthread_mutex_unlock(&sched_lock);
+
+        hint_client_enter(job->client);
+        run_phase(&job->phases[job->phase]);
+        hint_client_leave();
+
+        pthread_mutex_lock(&sched_lock);
+        running_job = NULL;
+        job->ran = true;
+        job->phase++;
+        if (!job->cancelled && job->phase < job->num_phases) {
+            job->deadline_ns += job->phases[job->phase].delay_ns;
+            heap_push(job);
+        } else {
+            free_job(job);
+        }
+        pthread_cond_broadcast(&sched_cond);
+    }
+}
+
+static void *hint_scheduler_thread(void *arg)
+{
+    struct epoll_event event;
+    uint64_t expirations;
+
+    (void)arg;
+
+    for (;;) {
+        if (epoll_wait(epoll_fd, &event, 1, -1) < 0) {
+            if (errno != EINTR)
+                ALOGE("%s: epoll_wait failed: %s", __func__, strerror(errno));
+            continue;
+        }
+
+        /* Non-blocking; fails with EAGAIN if the timer was re-armed. */
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0 &&
+                errno != EAGAIN)
+            ALOGE("%s: timerfd read failed: %s", __func__, strerror(errno));
+
+        pthread_mutex_lock(&sched_lock);
+        run_due_jobs();
+        arm_timer();
+        pthread_mutex_unlock(&sched_lock);
+    }
+
+    return NULL;
+}
+
+static void hint_scheduler_init(void)
+{
+    struct epoll_event event;
+    int ret;
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd < 0) {
+        ALOGE("%s: timerfd_create failed: %s", __func__, strerror(errno));
+        return;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        ALOGE("%s: epoll_create1 failed: %s", __func__, strerror(errno));
+        goto fail;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event)) {
+        ALOGE("%s: epoll_ctl failed: %s", __func__, strerror(errno));
+        goto fail;
+    }
+
+    ret = pthread_create(&sched_thread, NULL, hint_scheduler_thread, NULL);
+    if (ret) {
+        ALOGE("%s: pthread_create failed: %s", __func__, strerror(ret));
+        goto fail;
+    }
+    pthread_setname_np(sched_thread, "power-hint-sched");
+
+    return;
+
+fail:
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+    close(timer_fd);
+    epoll_fd = timer_fd = -1;
+}
+
+/*
+ * Queues a job of 'num_phases' steps. Returns its handle, or
+ * HINT_SCHED_INVALID if the scheduler is unavailable or full.
+ */
+unsigned int hint_schedule_sequence(const struct hint_phase *phases,
+        int num_phases)
+{
+    struct hint_job *job = NULL;
+    unsigned int id;
+    int i;
+
+    if (num_phases < 1 || num_phases > HINT_SCHED_MAX_PHASES)
+        return HINT_SCHED_INVALID;
+
+    for (i = 0; i < num_phases; i++) {
+        if (phases[i].delay_ms < 0 || phases[i].delay_us < 0 ||
+                phases[i].num_resources > HINT_SCHED_MAX_RESOURCES ||
+                (phases[i].action == HINT_PHASE_CALL && !phases[i].fn))
+            return HINT_SCHED_INVALID;
+    }
+
+    if (!power_clock_simulated()) {
+        pthread_once(&sched_once, hint_scheduler_init);
+        if (timer_fd < 0)
+            return HINT_SCHED_INVALID;
+    }
+
+    pthread_mutex_lock(&sched_lock);
+
+    for (i = 0; i < HINT_SCHED_MAX_JOBS; i++) {
+        if (jobs[i].id == HINT_SCHED_INVALID) {
+            job = &jobs[i];
+            break;
+        }
+    }
+    if (!job) {
+        pthread_mutex_unlock(&sched_lock);
+        ALOGE("%s: too many pending jobs", __func__);
+        return HINT_SCHED_INVALID;
+    }
+
+    id = next_job_id++;
+    if (next_job_id == HINT_SCHED_INVALID)
+        next_job_id++;
+
+    job->id = id;
+    job->phase = 0;
+    job->num_phases = num_phases;
+    job->ran = false;
+    job->cancelled = false;
+    job->client = hint_client_current();
+    for (i = 0; i < num_phases; i++) {
+        struct hint_job_phase *phase = &job->phases[i];
+
+        phase->delay_ns = phases[i].delay_ms * NSINMS +
+                phases[i].delay_us * NSINUS;
+        phase->action = phases[i].action;
+        phase->hint_id = phases[i].hint_id;
+        phase->num_resources = phases[i].num_resources;
+        if (phase->num_resources > 0)
+            memcpy(phase->resources, phases[i].resources,
+                    phase->num_resources * sizeof(int));
+        phase->fn = phases[i].fn;
+        phase->arg = phases[i].arg;
+    }
+    job->deadline_ns = power_clock_now_ns() + job->phases[0].delay_ns;
+    heap_push(job);
+
+    if (job->heap_index == 0)
+        arm_timer();
+
+    pthread_mutex_unlock(&sched_lock);
+
+    return id;
+}
+
+unsigned int hint_schedule_perform(int delay_ms, int hint_id,
+        const int *resources, int num_resources)
+{
+    struct hint_phase phase = {
+        .delay_ms = delay_ms,
+        .action = HINT_PHASE_PERFORM,
+        .hint_id = hint_id,
+        .resources = resources,
+        .num_resources = num_resources,
+    };
+
+    return hint_schedule_sequence(&phase, 1);
+}
+
+unsigned int hint_schedule_undo(int delay_ms, int hint_id)
+{
+    struct hint_phase phase = {
+        .delay_ms = delay_ms,
+        .action = HINT_PHASE_UNDO,
+        .hint_id = hint_id,
+    };
+
+    return hint_schedule_sequence(&phase, 1);
+}
+
+unsigned int hint_schedule_call(int delay_ms, void (*fn)(void *), void *arg)
+{
+    struct hint_phase phase = {
+        .delay_ms = delay_ms,
+        .action = HINT_PHASE_CALL,
+        .fn = fn,
+        .arg = arg,
+    };
+
+    return hint_schedule_sequence(&phase, 1);
+}
+
+unsigned int hint_schedule_call_us(int delay_us, void (*fn)(void *), void *arg)
+{
+    struct hint_phase phase = {
+        .delay_us = delay_us,
+        .action = HINT_PHASE_CALL,
+        .fn = fn,
+        .arg = arg,
+    };
+
+    return hint_schedule_sequence(&phase, 1);
+}
+
+static struct hint_job *find_job(unsigned int handle)
+{
+    int i;
+
+    for (i = 0; i < HINT_SCHED_MAX_JOBS; i++) {
+        if (jobs[i].id == handle)
+            return &jobs[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * Cancels the phases of 'handle' that haven't run yet. If a phase is
+ * running, waits for it to finish, unless called from a phase itself.
+ *
+ * Returns 0 if nothing had run, -EALREADY if some phases already ran,
+ * or -ENOENT if the handle is unknown or has finished.
+ */
+int hint_schedule_cancel(unsigned int handle)
+{
+    struct hint_job *job;
+    int ret;
+
+    if (handle == HINT_SCHED_INVALID)
+        return -ENOENT;
+
+    pthread_mutex_lock(&sched_lock);
+
+    job = find_job(handle);
+    if (!job) {
+        ret = -ENOENT;
+    } else if (job == running_job) {
+        job->cancelled = true;
+        if (!pthread_equal(pthread_self(), running_thread)) {
+            while (running_job == job && job->id == handle)
+                pthread_cond_wait(&sched_cond, &sched_lock);
+        }
+        ret = -EALREADY;
+    } else {
+        /* The timer may still fire for it; the thread just re-arms. */
+        ret = job->ran ? -EALREADY : 0;
+        heap_remove(job);
+        free_job(job);
+    }
+
+    pthread_mutex_unlock(&sched_lock);
+
+    return ret;
+}
+
+/* Earliest pending deadline, or 0 if nothing is queued. */
+long long hint_schedule_next_deadline(void)
+{
+    long long deadline;
+
+    pthread_mutex_lock(&sched_lock);
+    deadline = heap_size ? heap[0]->deadline_ns : 0;
+    pthread_mutex_unlock(&sched_lock);
+
+    return deadline;
+}
+
+/* Runs, on the calling thread, every phase due by power_clock_now_ns(). */
+void hint_schedule_run_due(void)
+{
+    pthread_mutex_lock(&sched_lock);
+    run_due_jobs();
+    pthread_mutex_unlock(&sched_lock);
+}
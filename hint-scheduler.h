@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_HINT_SCHEDULER_H
+#define _QCOM_POWER_HINT_SCHEDULER_H
+
+#include "perf-arbiter.h"
+#include "perf-native.h"
+
+/*
+ * Jobs kept by modules that hold at most one at a time: the batch
+ * flush, the audit (plus the one it is superseding), the client poll,
+ * the interaction trace reset and the delayed video encode hint.
+ */
+#define HINT_SCHED_FIXED_JOBS 8
+
+/*
+ * Room for every consumer at its worst at once, so none of them ever
+ * finds the pool full: an expiry per arbiter owner and per native lock,
+ * each of which briefly holds a second one while it is replaced, plus
+ * the fixed jobs above.
+ */
+#define HINT_SCHED_MAX_JOBS (PERF_ARBITER_MAX_OWNERS + PERF_NATIVE_MAX_LOCKS + \
+        2 + HINT_SCHED_FIXED_JOBS)
+#define HINT_SCHED_MAX_PHASES 4
+#define HINT_SCHED_MAX_RESOURCES 32
+
+/* Never returned for a scheduled job. */
+#define HINT_SCHED_INVALID 0
+
+enum hint_phase_action {
+    HINT_PHASE_PERFORM,     /* perform_hint_action(hint_id, resources) */
+    HINT_PHASE_UNDO,        /* undo_hint_action(hint_id) */
+    HINT_PHASE_CALL,        /* fn(arg) */
+};
+
+/*
+ * One step of a scheduled job, run delay_ms (plus delay_us) after the
+ * previous step (or after scheduling, for the first one). Resources are
+ * copied when the job is scheduled.
+ */
+struct hint_phase {
+    int delay_ms;
+    int delay_us;
+    enum hint_phase_action action;
+    int hint_id;
+    const int *resources;
+    int num_resources;
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+unsigned int hint_schedule_perform(int delay_ms, int hint_id,
+        const int *resources, int num_resources);
+unsigned int hint_schedule_undo(int delay_ms, int hint_id);
+unsigned int hint_schedule_call(int delay_ms, void (*fn)(void *), void *arg);
+unsigned int hint_schedule_call_us(int delay_us, void (*fn)(void *), void *arg);
+unsigned int hint_schedule_sequence(const struct hint_phase *phases,
+        int num_phases);
+int hint_schedule_cancel(unsigned int handle);
+
+/* For stepping a simulated power clock; see power-clock.h. */
+long long hint_schedule_next_deadline(void);
+void hint_schedule_run_due(void);
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <hardware/power.h>
+
+#include "hint-stats.h"
+
+/*
+ * Bucket 0 holds calls under 1us, bucket n holds [2^(n-1), 2^n) us and
+ * the last bucket everything from 2^(HINT_STATS_BUCKETS-2) us (~0.5s) up.
+ */
+#define HINT_STATS_BUCKETS 21
+
+/*
+ * Every field is updated with relaxed atomics so recording never takes a
+ * lock; a dump may see one call's fields partially applied, which is
+ * fine for diagnostics.
+ */
+struct hint_histogram {
+    atomic_uint_fast64_t calls;
+    atomic_uint_fast64_t handled;
+    atomic_uint_fast64_t suppressed;
+    atomic_uint_fast64_t errors;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+    atomic_uint_fast64_t buckets[HINT_STATS_BUCKETS];
+};
+
+static struct hint_histogram histograms[HINT_STATS_COUNT];
+static __thread enum hint_outcome current_outcome;
+
+static const char *stats_names[HINT_STATS_POWER_HINT] = {
+    [HINT_STATS_SET_INTERACTIVE] = "setInteractive",
+    [HINT_STATS_SET_FEATURE] = "setFeature",
+    [HINT_STATS_PLATFORM_STATS] = "getPlatformLowPowerStats",
+    [HINT_STATS_SUBSYSTEM_STATS] = "getSubsystemLowPowerStats",
+    [HINT_STATS_PERF_LOCK_ACQ] = "perf_lock_acq",
+    [HINT_STATS_PERF_LOCK_REL] = "perf_lock_rel",
+    [HINT_STATS_PERF_HINT] = "perf_hint",
+    [HINT_STATS_SYSFS_READ] = "sysfs_read",
+    [HINT_STATS_SYSFS_WRITE] = "sysfs_write",
+};
+
+static const char *power_hint_names[HINT_STATS_POWER_HINT_SLOTS] = {
+    [POWER_HINT_VSYNC] = "VSYNC",
+    [POWER_HINT_INTERACTION] = "INTERACTION",
+    [POWER_HINT_VIDEO_ENCODE] = "VIDEO_ENCODE",
+    [POWER_HINT_VIDEO_DECODE] = "VIDEO_DECODE",
+    [POWER_HINT_LOW_POWER] = "LOW_POWER",
+    [POWER_HINT_SUSTAINED_PERFORMANCE] = "SUSTAINED_PERFORMANCE",
+    [POWER_HINT_VR_MODE] = "VR_MODE",
+    [POWER_HINT_LAUNCH] = "LAUNCH",
+    [POWER_HINT_DISABLE_TOUCH] = "DISABLE_TOUCH",
+};
+
+enum hint_stats_id hint_stats_power_hint_id(int hint)
+{
+    if (hint < 0 || hint >= HINT_STATS_POWER_HINT_SLOTS)
+        return HINT_STATS_COUNT - 1;
+
+    return HINT_STATS_POWER_HINT + hint;
+}
+
+uint64_t hint_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int bucket_for(uint64_t elapsed_ns)
+{
+    uint64_t us = elapsed_ns / 1000;
+    unsigned int bucket;
+
+    if (us == 0)
+        return 0;
+
+    bucket = 64 - __builtin_clzll(us);
+    return bucket < HINT_STATS_BUCKETS ? bucket : HINT_STATS_BUCKETS - 1;
+}
+
+void hint_stats_record(enum hint_stats_id id, uint64_t elapsed_ns,
+        enum hint_outcome outcome)
+{
+    struct hint_histogram *h;
+    uint_fast64_t max;
+
+    if ((unsigned int)id >= HINT_STATS_COUNT)
+        return;
+
+    h = &histograms[id];
+    atomic_fetch_add_explicit(&h->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->total_ns, elapsed_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->buckets[bucket_for(elapsed_ns)], 1,
+            memory_order_relaxed);
+
+    switch (outcome) {
+        case HINT_OUTCOME_HANDLED:
+            atomic_fetch_add_explicit(&h->handled, 1, memory_order_relaxed);
+            break;
+        case HINT_OUTCOME_SUPPRESSED:
+            atomic_fetch_add_explicit(&h->suppressed, 1, memory_order_relaxed);
+            break;
+        case HINT_OUTCOME_ERROR:
+            atomic_fetch_add_explicit(&h->errors, 1, memory_order_relaxed);
+            break;
+        default:
+            break;
+    }
+
+    max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    while (elapsed_ns > max &&
+            !atomic_compare_exchange_weak_explicit(&h->max_ns, &max, elapsed_ns,
+                    memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+uint64_t hint_stats_begin(void)
+{
+    current_outcome = HINT_OUTCOME_NONE;
+
+    return hint_stats_now();
+}
+
+void hint_stats_end(enum hint_stats_id id, uint64_t start_ns)
+{
+    hint_stats_record(id, hint_stats_now() - start_ns, current_outcome);
+    current_outcome = HINT_OUTCOME_NONE;
+}
+
+void hint_stats_note(enum hint_outcome outcome)
+{
+    if (outcome > current_outcome)
+        current_outcome = outcome;
+}
+
+static void stats_name(enum hint_stats_id id, char *buf, size_t len)
+{
+    int hint;
+
+    if (id < HINT_STATS_POWER_HINT) {
+        snprintf(buf, len, "%s", stats_names[id]);
+        return;
+    }
+
+    hint = id - HINT_STATS_POWER_HINT;
+    if (hint >= HINT_STATS_POWER_HINT_SLOTS)
+        snprintf(buf, len, "powerHint(other)");
+    else if (power_hint_names[hint])
+        snprintf(buf, len, "powerHint(%s)", power_hint_names[hint]);
+    else
+        snprintf(buf, len, "powerHint(%d)", hint);
+}
+
+static void dump_buckets(int fd, struct hint_histogram *h)
+{
+    unsigned int i;
+
+    dprintf(fd, "    ");
+    for (i = 0; i < HINT_STATS_BUCKETS; i++) {
+        uint64_t count = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+
+        if (!count)
+            continue;
+        if (i == 0)
+            dprintf(fd, " <1us:%" PRIu64, count);
+        else
+            dprintf(fd, " %lluus:%" PRIu64, 1ULL << (i - 1), count);
+    }
+    dprintf(fd, "\n");
+}
+
+void hint_stats_dump(int fd)
+{
+    char name[48];
+    unsigned int i;
+
+    dprintf(fd, "Hint latency (buckets are lower bounds, log2 us):\n");
+    dprintf(fd, "%-36s %10s %10s %10s %8s %10s %10s\n", "call", "calls",
+            "handled", "suppressed", "errors", "mean(us)", "max(us)");
+
+    for (i = 0; i < HINT_STATS_COUNT; i++) {
+        struct hint_histogram *h = &histograms[i];
+        uint64_t calls = atomic_load_explicit(&h->calls, memory_order_relaxed);
+        uint64_t total_ns;
+
+        if (!calls)
+            continue;
+
+        total_ns = atomic_load_explicit(&h->total_ns, memory_order_relaxed);
+        stats_name(i, name, sizeof(name));
+        dprintf(fd, "%-36s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8" PRIu64
+                " %10" PRIu64 " %10" PRIu64 "\n", name, calls,
+                (uint64_t)atomic_load_explicit(&h->handled, memory_order_relaxed),
+                (uint64_t)atomic_load_explicit(&h->suppressed, memory_order_relaxed),
+                (uint64_t)atomic_load_explicit(&h->errors, memory_order_relaxed),
+                total_ns / calls / 1000,
+                (uint64_t)atomic_load_explicit(&h->max_ns, memory_order_relaxed) / 1000);
+        dump_buckets(fd, h);
+    }
+}
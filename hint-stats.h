@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_HINT_STATS_H
+#define _QCOM_POWER_HINT_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of powerHint values with their own histogram; the rest share one. */
+#define HINT_STATS_POWER_HINT_SLOTS 16
+
+enum hint_stats_id {
+    HINT_STATS_SET_INTERACTIVE = 0,
+    HINT_STATS_SET_FEATURE,
+    HINT_STATS_PLATFORM_STATS,
+    HINT_STATS_SUBSYSTEM_STATS,
+    HINT_STATS_PERF_LOCK_ACQ,
+    HINT_STATS_PERF_LOCK_REL,
+    HINT_STATS_PERF_HINT,
+    HINT_STATS_SYSFS_READ,
+    HINT_STATS_SYSFS_WRITE,
+    HINT_STATS_POWER_HINT,
+    /* One slot per powerHint value, plus one for out-of-range values. */
+    HINT_STATS_COUNT = HINT_STATS_POWER_HINT + HINT_STATS_POWER_HINT_SLOTS + 1
+};
+
+/* Ordered by precedence: a later note only ever raises the outcome. */
+enum hint_outcome {
+    HINT_OUTCOME_NONE = 0,
+    HINT_OUTCOME_HANDLED,
+    HINT_OUTCOME_SUPPRESSED,
+    HINT_OUTCOME_ERROR
+};
+
+enum hint_stats_id hint_stats_power_hint_id(int hint);
+
+/*
+ * Entry points bracket their work with hint_stats_begin()/hint_stats_end().
+ * Code below them reports what happened through hint_stats_note(), which
+ * is tracked per thread and folded into the histogram on end.
+ */
+uint64_t hint_stats_begin(void);
+void hint_stats_end(enum hint_stats_id id, uint64_t start_ns);
+void hint_stats_note(enum hint_outcome outcome);
+
+/* Records one timed call directly, without touching the per-thread note. */
+uint64_t hint_stats_now(void);
+void hint_stats_record(enum hint_stats_id id, uint64_t elapsed_ns,
+        enum hint_outcome outcome);
+
+void hint_stats_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Journal of the locks the HAL holds, kept in a shared file mapping so
+ * it survives the process: after a crash the kernel still has every
+ * store, and the next instance can find out what was left behind.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+
+#include "hint-client.h"
+#include "lock-journal.h"
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+
+static struct lock_journal_header *journal;
+static struct lock_journal_entry *entries;
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void read_boot_id(char *boot_id)
+{
+    ssize_t len = 0;
+    int fd;
+
+    memset(boot_id, 0, LOCK_JOURNAL_BOOT_ID_SIZE);
+    fd = open(BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        len = read(fd, boot_id, LOCK_JOURNAL_BOOT_ID_SIZE - 1);
+        close(fd);
+    }
+    if (len <= 0)
+        ALOGE("Unable to read %s", BOOT_ID_PATH);
+}
+
+static size_t journal_size(void)
+{
+    return sizeof(struct lock_journal_header) +
+            LOCK_JOURNAL_ENTRIES * sizeof(struct lock_journal_entry);
+}
+
+static bool journal_compatible(const struct lock_journal_header *header,
+        const char *boot_id)
+{
+    return header->magic == LOCK_JOURNAL_MAGIC &&
+            header->version == LOCK_JOURNAL_VERSION &&
+            header->entry_size == sizeof(struct lock_journal_entry) &&
+            header->num_entries == LOCK_JOURNAL_ENTRIES &&
+            !memcmp(header->boot_id, boot_id, LOCK_JOURNAL_BOOT_ID_SIZE);
+}
+
+int lock_journal_init(struct lock_journal_entry *recovered, int max)
+{
+    char path[PROPERTY_VALUE_MAX];
+
+    property_get(LOCK_JOURNAL_PROP, path, LOCK_JOURNAL_DEFAULT_PATH);
+
+    return lock_journal_open(path, recovered, max);
+}
+
+int lock_journal_open(const char *path, struct lock_journal_entry *recovered,
+        int max)
+{
+    char boot_id[LOCK_JOURNAL_BOOT_ID_SIZE];
+    struct lock_journal_header *header;
+    size_t size = journal_size();
+    struct stat st;
+    int count = 0;
+    int fd, ret, i;
+
+    if (journal)
+        return 0;
+
+    read_boot_id(boot_id);
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ALOGW("Unable to open %s, locks won't survive a restart: %s", path,
+                strerror(errno));
+        return 0;
+    }
+
+    if (fstat(fd, &st)) {
+        ALOGE("Unable to stat %s: %s", path, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    ret = posix_fallocate(fd, 0, size);
+    if (ret) {
+        ALOGE("Unable to size %s: %s", path, strerror(ret));
+        close(fd);
+        return 0;
+    }
+
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        ALOGE("Unable to map %s: %s", path, strerror(errno));
+        return 0;
+    }
+    entries = (struct lock_journal_entry *)(header + 1);
+
+    if ((size_t)st.st_size == size && journal_compatible(header, boot_id)) {
+        for (i = 0; i < LOCK_JOURNAL_ENTRIES && count < max; i++) {
+            if (__atomic_load_n(&entries[i].kind, __ATOMIC_ACQUIRE) !=
+                    LOCK_JOURNAL_FREE)
+                recovered[count++] = entries[i];
+        }
+        if (count)
+            ALOGI("Recovered %d lock(s) from a previous instance", count);
+    }
+
+    memset(header, 0, size);
+    header->magic = LOCK_JOURNAL_MAGIC;
+    header->version = LOCK_JOURNAL_VERSION;
+    header->entry_size = sizeof(struct lock_journal_entry);
+    header->num_entries = LOCK_JOURNAL_ENTRIES;
+    memcpy(header->boot_id, boot_id, LOCK_JOURNAL_BOOT_ID_SIZE);
+    __atomic_store_n(&journal, header, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+/* Called with journal_lock held. */
+static struct lock_journal_entry *find_entry(enum lock_journal_kind kind,
+        unsigned int id)
+{
+    int i;
+
+    for (i = 0; i < LOCK_JOURNAL_ENTRIES; i++) {
+        if (entries[i].kind == (uint32_t)kind && entries[i].id == id)
+            return &entries[i];
+    }
+
+    return NULL;
+}
+
+void lock_journal_add(enum lock_journal_kind kind, unsigned int id,
+        const int *resources, int num_resources)
+{
+    struct lock_journal_entry *entry;
+    struct hint_client owner = { 0, 0 };
+    uint64_t owner_start = 0;
+
+    if (!__atomic_load_n(&journal, __ATOMIC_ACQUIRE))
+        return;
+
+    if (kind == LOCK_JOURNAL_HINT) {
+        owner = hint_client_current();
+        if (owner.pid == getpid())
+            owner.pid = 0;
+        if (owner.pid)
+            owner_start = hint_client_start_time(owner.pid);
+    }
+
+    pthread_mutex_lock(&journal_lock);
+
+    entry = find_entry(kind, id);
+    if (!entry)
+        entry = find_entry(LOCK_JOURNAL_FREE, 0);
+    if (!entry) {
+        pthread_mutex_unlock(&journal_lock);
+        ALOGE("Lock journal full, not recording 0x%x", id);
+        return;
+    }
+
+    /* Retire the entry while it is rewritten. */
+    __atomic_store_n(&entry->kind, LOCK_JOURNAL_FREE, __ATOMIC_RELEASE);
+
+    entry->id = id;
+    entry->owner_pid = owner.pid;
+    entry->owner_uid = owner.uid;
+    entry->owner_start = owner_start;
+    if (num_resources > LOCK_JOURNAL_MAX_RESOURCES) {
+        entry->num_resources = -1;
+    } else {
+        entry->num_resources = num_resources;
+        if (num_resources > 0)
+            memcpy(entry->resources, resources, num_resources * sizeof(int));
+    }
+
+    __atomic_store_n(&entry->kind, kind, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&journal_lock);
+}
+
+void lock_journal_remove(enum lock_journal_kind kind, unsigned int id)
+{
+    struct lock_journal_entry *entry;
+
+    if (!__atomic_load_n(&journal, __ATOMIC_ACQUIRE))
+        return;
+
+    pthread_mutex_lock(&journal_lock);
+    entry = find_entry(kind, id);
+    if (entry) {
+        __atomic_store_n(&entry->kind, LOCK_JOURNAL_FREE, __ATOMIC_RELEASE);
+        entry->id = 0;
+    }
+    pthread_mutex_unlock(&journal_lock);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_LOCK_JOURNAL_H
+#define _QCOM_POWER_LOCK_JOURNAL_H
+
+#include <stdint.h>
+
+#define LOCK_JOURNAL_PROP "vendor.power.journal"
+/* The directory is created by the service's init script. */
+#define LOCK_JOURNAL_DEFAULT_PATH "/data/vendor/power/lock_journal"
+
+#define LOCK_JOURNAL_ENTRIES 128
+#define LOCK_JOURNAL_MAX_RESOURCES 32
+
+/*
+ * File layout: one header followed by LOCK_JOURNAL_ENTRIES fixed-size
+ * entries. An entry is filled in before its 'kind' is stored, and its
+ * 'kind' is cleared before it is reused, so a crash at any point leaves
+ * every entry either complete or free.
+ */
+#define LOCK_JOURNAL_MAGIC 0x4e524a50u  /* "PJRN" */
+#define LOCK_JOURNAL_VERSION 1
+#define LOCK_JOURNAL_BOOT_ID_SIZE 40
+
+enum lock_journal_kind {
+    LOCK_JOURNAL_FREE = 0,
+    LOCK_JOURNAL_PERFD,         /* an indefinite lock held with perfd */
+    LOCK_JOURNAL_HINT,          /* an active perform_hint_action() hint */
+};
+
+struct lock_journal_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t num_entries;
+    /* Entries from another boot refer to a perfd that is long gone. */
+    char boot_id[LOCK_JOURNAL_BOOT_ID_SIZE];
+    uint64_t reserved[1];
+};
+
+struct lock_journal_entry {
+    uint32_t kind;
+    uint32_t id;                /* perfd handle or hint id */
+    int32_t owner_pid;          /* 0 if unattributed */
+    int32_t owner_uid;
+    uint64_t owner_start;       /* see hint_client_start_time() */
+    int32_t num_resources;      /* -1 if the list did not fit */
+    int32_t resources[LOCK_JOURNAL_MAX_RESOURCES];
+    int32_t reserved;
+};
+
+/*
+ * Maps the journal named by LOCK_JOURNAL_PROP. Entries left behind by
+ * a previous instance of the HAL during this boot are copied to
+ * 'recovered' (up to 'max') and the journal is then cleared. Returns
+ * how many were copied.
+ */
+int lock_journal_init(struct lock_journal_entry *recovered, int max);
+
+/* lock_journal_init() on the journal at 'path'. Tests call this directly. */
+int lock_journal_open(const char *path, struct lock_journal_entry *recovered,
+        int max);
+
+/*
+ * Records a lock. HINT entries are attributed to the current hint
+ * client. Adding an id already present replaces it.
+ */
+void lock_journal_add(enum lock_journal_kind kind, unsigned int id,
+        const int *resources, int num_resources);
+void lock_journal_remove(enum lock_journal_kind kind, unsigned int id);
+
+#endif
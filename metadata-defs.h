@@ -27,13 +27,18 @@
  *
  */
 
+#include <stddef.h>
+
 #define ATTRIBUTE_VALUE_DELIM ('=')
-#define ATTRIBUTE_STRING_DELIM (";")
+#define ATTRIBUTE_STRING_DELIM (';')
 
 #define METADATA_PARSING_ERR (-1)
 #define METADATA_PARSING_CONTINUE (0)
 #define METADATA_PARSING_DONE (1)
 
+/* Power of two, larger than the biggest schema. */
+#define METADATA_HASH_SLOTS (16)
+
 #define MIN(x,y) (((x)>(y))?(y):(x))
 
 struct video_encode_metadata_t {
@@ -46,8 +51,47 @@ struct video_decode_metadata_t {
     int state;
 };
 
-int parse_metadata(char *metadata, char **metadata_saveptr,
-    char *attribute, unsigned int attribute_size, char *value, unsigned int value_size);
+/* A view of part of the metadata string; not NUL terminated. */
+struct metadata_token {
+    const char *str;
+    unsigned int len;
+};
+
+enum metadata_field_type {
+    METADATA_INT,
+    METADATA_BOOL,      /* "0"/"1"/"false"/"true", stored as int */
+    METADATA_ENUM,      /* one of enum_values, stored as int */
+};
+
+struct metadata_enum_value {
+    const char *name;
+    int value;
+};
+
+struct metadata_field {
+    const char *name;
+    enum metadata_field_type type;
+    size_t offset;      /* of the int in the output struct */
+    const struct metadata_enum_value *enum_values; /* NULL terminated */
+};
+
+/*
+ * Describes the attributes of one metadata struct. The hash fields are
+ * filled in by metadata_schema_init() so that every field name lands
+ * in its own slot.
+ */
+struct metadata_schema {
+    const struct metadata_field *fields;
+    unsigned int num_fields;
+    unsigned int seed;
+    unsigned char slots[METADATA_HASH_SLOTS]; /* field index + 1, 0 if free */
+};
+
+int parse_metadata(const char **metadata, struct metadata_token *attribute,
+        struct metadata_token *value);
+int metadata_schema_init(struct metadata_schema *schema);
+int parse_metadata_schema(const char *metadata,
+        const struct metadata_schema *schema, void *out);
 int parse_video_encode_metadata(char *metadata,
     struct video_encode_metadata_t *video_encode_metadata);
 int parse_video_decode_metadata(char *metadata,
@@ -27,96 +27,218 @@
  *
  */
 
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "metadata-defs.h"
 
-int parse_metadata(char *metadata, char **metadata_saveptr,
-        char *attribute, unsigned int attribute_size, char *value, unsigned int value_size)
+#define METADATA_HASH_MAX_SEED (1 << 16)
+
+/*
+ * Yields the next "attribute=value" pair of *metadata as views into the
+ * caller's string, which is left untouched, and advances *metadata past
+ * it. Pairs without a '=' come back with an empty attribute.
+ */
+int parse_metadata(const char **metadata, struct metadata_token *attribute,
+        struct metadata_token *value)
 {
-    char *attribute_string;
-    char *attribute_value_delim;
-    unsigned int bytes_to_copy;
+    const char *p = *metadata;
+    const char *delim = NULL;
+    const char *start;
 
-    attribute_string = strtok_r(metadata, ATTRIBUTE_STRING_DELIM,
-            metadata_saveptr);
+    while (*p == ATTRIBUTE_STRING_DELIM)
+        p++;
 
-    if (attribute_string == NULL)
+    if (*p == '\0') {
+        *metadata = p;
         return METADATA_PARSING_DONE;
+    }
 
-    attribute[0] = value[0] = '\0';
-
-    if ((attribute_value_delim = strchr(attribute_string,
-                    ATTRIBUTE_VALUE_DELIM)) != NULL) {
-        unsigned int attribute_len = (unsigned int) (attribute_value_delim - attribute_string);
-        /* copy only attribute len + NUL character, or as much as can be fit */
-        bytes_to_copy = MIN(attribute_len + 1, attribute_size);
+    for (start = p; *p != '\0' && *p != ATTRIBUTE_STRING_DELIM; p++) {
+        if (!delim && *p == ATTRIBUTE_VALUE_DELIM)
+            delim = p;
+    }
+    *metadata = p;
 
-        strlcpy(attribute, attribute_string, bytes_to_copy);
-        strlcpy(value, attribute_value_delim + 1, value_size);
+    if (!delim) {
+        attribute->str = value->str = start;
+        attribute->len = value->len = 0;
+    } else {
+        attribute->str = start;
+        attribute->len = delim - start;
+        value->str = delim + 1;
+        value->len = p - (delim + 1);
     }
 
     return METADATA_PARSING_CONTINUE;
 }
 
-int parse_video_encode_metadata(char *metadata,
-    struct video_encode_metadata_t *video_encode_metadata)
+static unsigned int metadata_hash(const char *str, unsigned int len,
+        unsigned int seed)
 {
-    char attribute[1024], value[1024], *saveptr;
-    char *temp_metadata = metadata;
-    int parsing_status;
+    unsigned int hash = 2166136261u ^ seed;
+    unsigned int i;
 
-    while ((parsing_status = parse_metadata(temp_metadata, &saveptr,
-            attribute, sizeof(attribute), value, sizeof(value))) == METADATA_PARSING_CONTINUE) {
-        if (strlen(attribute) == strlen("hint_id") &&
-            (strncmp(attribute, "hint_id", strlen("hint_id")) == 0)) {
-            if (strlen(value) > 0) {
-                video_encode_metadata->hint_id = atoi(value);
-            }
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash & (METADATA_HASH_SLOTS - 1);
+}
+
+/*
+ * Finds a seed for which every field name hashes to a distinct slot.
+ * Returns -EINVAL if the schema is too large or has duplicate names.
+ */
+int metadata_schema_init(struct metadata_schema *schema)
+{
+    unsigned int seed, i;
+
+    if (schema->num_fields > METADATA_HASH_SLOTS)
+        return -EINVAL;
+
+    for (seed = 0; seed < METADATA_HASH_MAX_SEED; seed++) {
+        memset(schema->slots, 0, sizeof(schema->slots));
+
+        for (i = 0; i < schema->num_fields; i++) {
+            const char *name = schema->fields[i].name;
+            unsigned int slot = metadata_hash(name, strlen(name), seed);
+
+            if (schema->slots[slot])
+                break;
+            schema->slots[slot] = i + 1;
         }
 
-        if (strlen(attribute) == strlen("state") &&
-            (strncmp(attribute, "state", strlen("state")) == 0)) {
-            if (strlen(value) > 0) {
-                video_encode_metadata->state = atoi(value);
-            }
+        if (i == schema->num_fields) {
+            schema->seed = seed;
+            return 0;
         }
+    }
+
+    memset(schema->slots, 0, sizeof(schema->slots));
+    return -EINVAL;
+}
+
+static const struct metadata_field *find_field(
+        const struct metadata_schema *schema, const struct metadata_token *key)
+{
+    const struct metadata_field *field;
+    unsigned int slot;
+
+    slot = schema->slots[metadata_hash(key->str, key->len, schema->seed)];
+    if (!slot)
+        return NULL;
+
+    field = &schema->fields[slot - 1];
+    if (strncmp(field->name, key->str, key->len) || field->name[key->len] != '\0')
+        return NULL;
+
+    return field;
+}
+
+static int token_equals(const struct metadata_token *token, const char *str)
+{
+    return !strncmp(str, token->str, token->len) && str[token->len] == '\0';
+}
+
+/*
+ * Same rules as atoi(), but bounded by the token and rejecting junk.
+ * Whitespace is allowed on either side, e.g. "state=1\n".
+ */
+static int parse_int(const struct metadata_token *token, int *out)
+{
+    const char *p = token->str;
+    const char *end = token->str + token->len;
+    long long value = 0;
+    int negative = 0;
+
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+    while (end > p && isspace((unsigned char)end[-1]))
+        end--;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end)
+        return -EINVAL;
 
-        temp_metadata = NULL;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9')
+            return -EINVAL;
+        value = value * 10 + (*p - '0');
+        if (value > (long long)INT_MAX + 1)
+            return -ERANGE;
     }
 
-    if (parsing_status == METADATA_PARSING_ERR)
-        return -1;
+    if (negative)
+        value = -value;
+    if (value > INT_MAX)
+        return -ERANGE;
 
+    *out = (int)value;
     return 0;
 }
 
-int parse_video_decode_metadata(char *metadata,
-    struct video_decode_metadata_t *video_decode_metadata)
+static int parse_field(const struct metadata_field *field,
+        const struct metadata_token *value, int *out)
 {
-    char attribute[1024], value[1024], *saveptr;
-    char *temp_metadata = metadata;
-    int parsing_status;
+    const struct metadata_enum_value *e;
 
-    while ((parsing_status = parse_metadata(temp_metadata, &saveptr,
-            attribute, sizeof(attribute), value, sizeof(value))) == METADATA_PARSING_CONTINUE) {
-        if (strlen(attribute) == strlen("hint_id") &&
-            (strncmp(attribute, "hint_id", strlen("hint_id")) == 0)) {
-            if (strlen(value) > 0) {
-                video_decode_metadata->hint_id = atoi(value);
+    switch (field->type) {
+        case METADATA_INT:
+            return parse_int(value, out);
+        case METADATA_BOOL:
+            if (token_equals(value, "1") || token_equals(value, "true")) {
+                *out = 1;
+                return 0;
             }
-        }
-
-        if (strlen(attribute) == strlen("state") &&
-            (strncmp(attribute, "state", strlen("state")) == 0)) {
-            if (strlen(value) > 0) {
-                video_decode_metadata->state = atoi(value);
+            if (token_equals(value, "0") || token_equals(value, "false")) {
+                *out = 0;
+                return 0;
             }
-        }
+            return -EINVAL;
+        case METADATA_ENUM:
+            for (e = field->enum_values; e && e->name; e++) {
+                if (token_equals(value, e->name)) {
+                    *out = e->value;
+                    return 0;
+                }
+            }
+            return -EINVAL;
+    }
+
+    return -EINVAL;
+}
+
+/*
+ * Fills the fields of 'out' described by 'schema' from the metadata
+ * string. Unknown attributes, empty values and values that don't parse
+ * as the field's type are skipped, leaving the caller's default.
+ */
+int parse_metadata_schema(const char *metadata,
+        const struct metadata_schema *schema, void *out)
+{
+    struct metadata_token attribute, value;
+    int parsing_status;
+
+    while ((parsing_status = parse_metadata(&metadata, &attribute, &value)) ==
+            METADATA_PARSING_CONTINUE) {
+        const struct metadata_field *field;
+        int parsed;
+
+        if (!attribute.len || !value.len)
+            continue;
 
-        temp_metadata = NULL;
+        field = find_field(schema, &attribute);
+        if (!field)
+            continue;
+
+        if (parse_field(field, &value, &parsed) == 0)
+            *(int *)((char *)out + field->offset) = parsed;
     }
 
     if (parsing_status == METADATA_PARSING_ERR)
@@ -124,3 +246,43 @@ int parse_video_decode_metadata(char *metadata,
 
     return 0;
 }
+
+static const struct metadata_field video_encode_fields[] = {
+    { "hint_id", METADATA_INT, offsetof(struct video_encode_metadata_t, hint_id), NULL },
+    { "state", METADATA_INT, offsetof(struct video_encode_metadata_t, state), NULL },
+};
+
+static const struct metadata_field video_decode_fields[] = {
+    { "hint_id", METADATA_INT, offsetof(struct video_decode_metadata_t, hint_id), NULL },
+    { "state", METADATA_INT, offsetof(struct video_decode_metadata_t, state), NULL },
+};
+
+static struct metadata_schema video_encode_schema = {
+    .fields = video_encode_fields,
+    .num_fields = sizeof(video_encode_fields) / sizeof(video_encode_fields[0]),
+};
+
+static struct metadata_schema video_decode_schema = {
+    .fields = video_decode_fields,
+    .num_fields = sizeof(video_decode_fields) / sizeof(video_decode_fields[0]),
+};
+
+static void __attribute__((constructor)) metadata_schemas_init(void)
+{
+    metadata_schema_init(&video_encode_schema);
+    metadata_schema_init(&video_decode_schema);
+}
+
+int parse_video_encode_metadata(char *metadata,
+    struct video_encode_metadata_t *video_encode_metadata)
+{
+    return parse_metadata_schema(metadata, &video_encode_schema,
+            video_encode_metadata);
+}
+
+int parse_video_decode_metadata(char *metadata,
+    struct video_decode_metadata_t *video_decode_metadata)
+{
+    return parse_metadata_schema(metadata, &video_decode_schema,
+            video_decode_metadata);
+}
@@ -0,0 +1,584 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Resolves overlapping perf lock requests inside the HAL.
+ *
+ * Every request is an owner holding a list of resources until it is
+ * released or runs out. For each opcode the effective value is the
+ * highest floor, the lowest cap or the union of flags over all owners
+ * asking for it; for opaque resources the newest request wins. Only
+ * opcodes an owner change actually touched are recomputed, and a
+ * request that does not change the outcome costs no perfd call at all.
+ *
+ * What a recompute changes reaches perfd as one lock. Since a lock
+ * keeps applying every value it was taken with, any lock holding a
+ * changed opcode is replaced as a whole (new one first), its unchanged
+ * opcodes included. Each lock is timed to outlast the longest-lived
+ * owner behind it, so perfd still lets it lapse should an expiry here
+ * go missing.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-scheduler.h"
+#include "perf-arbiter.h"
+#include "perf-resource.h"
+#include "power-clock.h"
+
+#define NSINMS 1000000LL
+
+/*
+ * Timed locks are taken for this many times the time left, so that
+ * most renewals fall within them and cost nothing. Owners still run
+ * out on time here; the slack only matters if that goes wrong.
+ */
+#define LOCK_SLACK 2
+
+struct arbiter_owner {
+    int handle;                         /* 0 while free */
+    unsigned long long seq;             /* order of the last request */
+    long long expires_ns;               /* 0 = held until released */
+    unsigned int timer;
+    int num_resources;
+    struct perf_resource resources[PERF_ARBITER_MAX_RESOURCES];
+};
+
+/* An opcode with at least one owner, and the lock applying it. */
+struct arbiter_opcode {
+    uint32_t opcode;
+    int num_owners;                     /* 0 while free */
+    int32_t value;                      /* effective value */
+    int winner;                         /* owner that set 'value' */
+    long long until_ns;                 /* when 'value' may lapse, 0 = never */
+    int lock;                           /* index in locks[], -1 if none */
+};
+
+/* A lock held downstream, applying one or more opcodes. */
+struct downstream_lock {
+    int handle;                         /* 0 while free */
+    int num_opcodes;
+    long long expires_ns;               /* 0 = held until released */
+};
+
+static pthread_mutex_t arbiter_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct perf_arbiter_ops arbiter_ops;
+static int next_id = 1;
+static unsigned long long next_seq;
+static struct arbiter_owner owners[PERF_ARBITER_MAX_OWNERS];
+static struct arbiter_opcode opcodes[PERF_ARBITER_MAX_OPCODES];
+/* At most one per opcode, since every lock applies at least one. */
+static struct downstream_lock locks[PERF_ARBITER_MAX_OPCODES];
+
+/* Locks taken or renewed, and recomputed opcodes left as they were. */
+static unsigned long long num_applied, num_unchanged;
+
+static const char *kind_names[] = {
+    [PERF_RESOURCE_OPAQUE] = "opaque",
+    [PERF_RESOURCE_FLOOR] = "floor",
+    [PERF_RESOURCE_CAP] = "cap",
+    [PERF_RESOURCE_FLAG] = "flag",
+};
+
+void perf_arbiter_init(const struct perf_arbiter_ops *ops)
+{
+    arbiter_ops = *ops;
+}
+
+static bool is_arbiter_handle(int handle)
+{
+    return handle >= PERF_ARBITER_HANDLE_BASE &&
+            handle < PERF_ARBITER_HANDLE_BASE + PERF_ARBITER_HANDLE_BASE / 2;
+}
+
+static struct arbiter_owner *find_owner(int handle)
+{
+    int i;
+
+    for (i = 0; i < PERF_ARBITER_MAX_OWNERS; i++) {
+        if (owners[i].handle == handle)
+            return &owners[i];
+    }
+
+    return NULL;
+}
+
+static const struct perf_resource *owner_resource(const struct arbiter_owner *owner,
+        uint32_t opcode)
+{
+    int i;
+
+    for (i = 0; i < owner->num_resources; i++) {
+        if (owner->resources[i].opcode == opcode)
+            return &owner->resources[i];
+    }
+
+    return NULL;
+}
+
+static struct arbiter_opcode *find_opcode(uint32_t opcode)
+{
+    int i;
+
+    for (i = 0; i < PERF_ARBITER_MAX_OPCODES; i++) {
+        if (opcodes[i].num_owners && opcodes[i].opcode == opcode)
+            return &opcodes[i];
+    }
+
+    return NULL;
+}
+
+static struct arbiter_opcode *add_opcode(uint32_t opcode)
+{
+    int i;
+
+    for (i = 0; i < PERF_ARBITER_MAX_OPCODES; i++) {
+        if (!opcodes[i].num_owners) {
+            opcodes[i].opcode = opcode;
+            opcodes[i].lock = -1;
+            return &opcodes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* The later of two deadlines, where 0 means never. */
+static long long later(long long a_ns, long long b_ns)
+{
+    if (!a_ns || !b_ns)
+        return 0;
+
+    return a_ns > b_ns ? a_ns : b_ns;
+}
+
+/*
+ * Computes the effective value of 'opcode' over every live owner, and
+ * until when it must be held: as long as any owner backing that value
+ * (every owner, for flags) is left. Returns the number of owners.
+ */
+static int evaluate(uint32_t opcode, long long now, int32_t *value,
+        int *winner, long long *until_ns)
+{
+    enum perf_resource_kind kind = perf_resource_kind(opcode);
+    unsigned long long newest = 0;
+    int num_owners = 0, i;
+
+    for (i = 0; i < PERF_ARBITER_MAX_OWNERS; i++) {
+        const struct arbiter_owner *owner = &owners[i];
+        const struct perf_resource *res;
+        bool wins;
+
+        if (!owner->handle || (owner->expires_ns && owner->expires_ns <= now) ||
+                !(res = owner_resource(owner, opcode)))
+            continue;
+
+        if (!num_owners) {
+            wins = true;
+        } else {
+            switch (kind) {
+                case PERF_RESOURCE_FLOOR:
+                    wins = res->value > *value;
+                    break;
+                case PERF_RESOURCE_CAP:
+                    wins = res->value < *value;
+                    break;
+                case PERF_RESOURCE_FLAG:
+                    *value |= res->value;
+                    wins = false;
+                    break;
+                default:
+                    wins = owner->seq > newest;
+                    break;
+            }
+        }
+
+        if (wins) {
+            *until_ns = kind == PERF_RESOURCE_FLAG && num_owners ?
+                    later(*until_ns, owner->expires_ns) : owner->expires_ns;
+            *value = res->value;
+            *winner = owner->handle;
+        } else if (kind == PERF_RESOURCE_FLAG ||
+                (kind != PERF_RESOURCE_OPAQUE && res->value == *value)) {
+            *until_ns = later(*until_ns, owner->expires_ns);
+        }
+        if (owner->seq > newest)
+            newest = owner->seq;
+        num_owners++;
+    }
+
+    return num_owners;
+}
+
+/* Whether 'lock' is held at least until 'until_ns'. */
+static bool lock_covers(const struct downstream_lock *lock, long long until_ns)
+{
+    return !lock->expires_ns || (until_ns && until_ns <= lock->expires_ns);
+}
+
+/* End of a lock taken at 'now' for values needed until 'until_ns'. */
+static long long lock_end_ns(long long until_ns, long long now)
+{
+    if (!until_ns)
+        return 0;
+
+    return now + (until_ns > now ? (until_ns - now) * LOCK_SLACK : NSINMS);
+}
+
+static int duration_ms(long long end_ns, long long now)
+{
+    if (!end_ns)
+        return 0;
+
+    /* Round up so the lock never ends before its owners do. */
+    return (end_ns - now + NSINMS - 1) / NSINMS;
+}
+
+/*
+ * Recomputes every opcode in 'touched' (duplicates are fine) and takes
+ * one lock for what changed, replacing each lock that applied any of it.
+ * Opcodes that could not be applied before are retried along the way.
+ * Called with arbiter_lock held.
+ */
+static void arbitrate(const uint32_t *touched, int num_touched)
+{
+    struct perf_resource set[PERF_ARBITER_MAX_OPCODES];
+    struct arbiter_opcode *group[PERF_ARBITER_MAX_OPCODES];
+    bool replaced[PERF_ARBITER_MAX_OPCODES] = { false };
+    int list[PERF_ARBITER_MAX_OPCODES * 2];
+    long long now = power_clock_now_ns();
+    long long until_ns = 1, end_ns;
+    bool moved = false;
+    int num_group = 0, num_replaced = 0, renew = -1;
+    int num_args, handle, i, j;
+
+    for (i = 0; i < num_touched; i++) {
+        struct arbiter_opcode *entry = find_opcode(touched[i]);
+        long long opcode_until_ns = 0;
+        int32_t value = 0;
+        int winner = 0, num_owners;
+
+        for (j = 0; j < i && touched[j] != touched[i]; j++)
+            ;
+        if (j < i)
+            continue;
+
+        num_owners = evaluate(touched[i], now, &value, &winner, &opcode_until_ns);
+        if (!num_owners) {
+            if (entry) {
+                if (entry->lock >= 0) {
+                    replaced[entry->lock] = true;
+                    locks[entry->lock].num_opcodes--;
+                }
+                entry->num_owners = 0;
+                moved = true;
+            }
+            continue;
+        }
+
+        if (!entry && !(entry = add_opcode(touched[i]))) {
+            ALOGE("%s: too many resources, dropping 0x%x", __func__, touched[i]);
+            continue;
+        }
+        entry->num_owners = num_owners;
+        entry->winner = winner;
+
+        if (entry->lock >= 0 && entry->value == value &&
+                lock_covers(&locks[entry->lock], opcode_until_ns)) {
+            entry->until_ns = opcode_until_ns;
+            num_unchanged++;
+            continue;
+        }
+
+        if (entry->lock >= 0)
+            replaced[entry->lock] = true;
+        if (entry->lock < 0 || entry->value != value)
+            moved = true;
+        entry->value = value;
+        entry->until_ns = opcode_until_ns;
+    }
+
+    /* Everything a replaced lock still applies moves to the new one. */
+    for (i = 0; i < PERF_ARBITER_MAX_OPCODES; i++) {
+        struct arbiter_opcode *entry = &opcodes[i];
+
+        if (!entry->num_owners || (entry->lock >= 0 && !replaced[entry->lock]))
+            continue;
+        if (entry->lock < 0)
+            moved = true;
+
+        group[num_group] = entry;
+        set[num_group].opcode = entry->opcode;
+        set[num_group].value = entry->value;
+        num_group++;
+
+        if (!entry->until_ns)
+            until_ns = 0;
+        else if (until_ns && entry->until_ns > until_ns)
+            until_ns = entry->until_ns;
+    }
+
+    for (i = 0; i < PERF_ARBITER_MAX_OPCODES; i++) {
+        if (replaced[i]) {
+            renew = i;
+            num_replaced++;
+        }
+    }
+    /* Only the lifetime of a single lock moved: renew it in place. */
+    if (moved || num_replaced != 1 || locks[renew].num_opcodes != num_group)
+        renew = -1;
+
+    end_ns = lock_end_ns(until_ns, now);
+    handle = -1;
+    if (num_group) {
+        num_args = perf_resource_encode(set, num_group, list,
+                PERF_ARBITER_MAX_OPCODES * 2);
+        if (num_args > 0)
+            handle = arbiter_ops.acquire(renew >= 0 ? locks[renew].handle : 0,
+                    duration_ms(end_ns, now), list, num_args);
+        if (handle == -1)
+            ALOGE("%s: failed to apply %d resource(s)", __func__, num_group);
+        else
+            num_applied++;
+    }
+
+    if (renew >= 0 && handle != -1) {
+        /* Downstream may hand out a new lock instead of renewing. */
+        if (handle != locks[renew].handle)
+            arbiter_ops.release(locks[renew].handle);
+        locks[renew].handle = handle;
+        locks[renew].expires_ns = end_ns;
+        return;
+    }
+
+    /*
+     * On failure the replaced locks go anyway: stale values must not
+     * linger, and opcodes left without a lock are retried next time.
+     */
+    for (i = 0; i < PERF_ARBITER_MAX_OPCODES; i++) {
+        if (replaced[i]) {
+            arbiter_ops.release(locks[i].handle);
+            locks[i].handle = 0;
+        }
+    }
+
+    for (i = 0; i < num_group; i++)
+        group[i]->lock = -1;
+    if (handle == -1)
+        return;
+
+    /* Every lock applies an opcode, so one is always free. */
+    for (i = 0; locks[i].handle; i++)
+        ;
+    locks[i].handle = handle;
+    locks[i].num_opcodes = num_group;
+    locks[i].expires_ns = end_ns;
+    for (j = 0; j < num_group; j++)
+        group[j]->lock = i;
+}
+
+/* Recomputes the opcodes of 'resources' and 'old'. Called with arbiter_lock held. */
+static void arbitrate_resources(const struct perf_resource *resources, int num,
+        const struct perf_resource *old, int num_old)
+{
+    uint32_t touched[PERF_ARBITER_MAX_RESOURCES * 2];
+    int i;
+
+    for (i = 0; i < num; i++)
+        touched[i] = resources[i].opcode;
+    for (i = 0; i < num_old; i++)
+        touched[num + i] = old[i].opcode;
+
+    arbitrate(touched, num + num_old);
+}
+
+static void expire_owner(void *arg);
+static unsigned int release_owner(struct arbiter_owner *owner);
+
+int perf_arbiter_acquire(int handle, int duration, int list[], int num_args)
+{
+    struct perf_resource resources[PERF_ARBITER_MAX_RESOURCES];
+    struct perf_resource old[PERF_ARBITER_MAX_RESOURCES];
+    struct arbiter_owner *owner = NULL;
+    unsigned int timer = HINT_SCHED_INVALID, old_timer;
+    int num, num_old;
+
+    if (duration < 0)
+        return -1;
+
+    num = perf_resource_parse(list, num_args, resources, PERF_ARBITER_MAX_RESOURCES);
+    if (num <= 0)
+        goto direct;
+
+    pthread_mutex_lock(&arbiter_lock);
+
+    if (is_arbiter_handle(handle))
+        owner = find_owner(handle);
+    if (!owner)
+        owner = find_owner(0);
+    if (!owner) {
+        pthread_mutex_unlock(&arbiter_lock);
+        ALOGV("%s: too many owners", __func__);
+        goto direct;
+    }
+
+    if (!owner->handle) {
+        owner->handle = PERF_ARBITER_HANDLE_BASE + next_id;
+        next_id = next_id < PERF_ARBITER_HANDLE_BASE / 2 - 1 ? next_id + 1 : 1;
+        owner->timer = HINT_SCHED_INVALID;
+        owner->num_resources = 0;
+    }
+
+    /* An owner that can't run out here is left to perfd's own timer. */
+    if (duration) {
+        timer = hint_schedule_call(duration, expire_owner,
+                (void *)(intptr_t)owner->handle);
+        if (timer == HINT_SCHED_INVALID) {
+            ALOGE("%s: unable to schedule expiry of 0x%x, going direct",
+                    __func__, owner->handle);
+            old_timer = release_owner(owner);
+            pthread_mutex_unlock(&arbiter_lock);
+            if (old_timer != HINT_SCHED_INVALID)
+                hint_schedule_cancel(old_timer);
+            goto direct;
+        }
+    }
+
+    num_old = owner->num_resources;
+    memcpy(old, owner->resources, num_old * sizeof(old[0]));
+
+    owner->seq = ++next_seq;
+    owner->num_resources = num;
+    memcpy(owner->resources, resources, num * sizeof(resources[0]));
+    owner->expires_ns = duration ? power_clock_now_ns() + duration * NSINMS : 0;
+
+    old_timer = owner->timer;
+    owner->timer = timer;
+
+    arbitrate_resources(owner->resources, num, old, num_old);
+    handle = owner->handle;
+
+    pthread_mutex_unlock(&arbiter_lock);
+
+    /* Outside the lock: a running expire_owner() may be waiting for it. */
+    if (old_timer != HINT_SCHED_INVALID)
+        hint_schedule_cancel(old_timer);
+
+    return handle;
+
+direct:
+    return arbiter_ops.acquire(is_arbiter_handle(handle) ? 0 : handle, duration,
+            list, num_args);
+}
+
+/* Called with arbiter_lock held. Returns the timer left to cancel. */
+static unsigned int release_owner(struct arbiter_owner *owner)
+{
+    unsigned int timer = owner->timer;
+
+    owner->handle = 0;
+    owner->timer = HINT_SCHED_INVALID;
+    arbitrate_resources(owner->resources, owner->num_resources, NULL, 0);
+    owner->num_resources = 0;
+
+    return timer;
+}
+
+int perf_arbiter_release(int handle)
+{
+    struct arbiter_owner *owner;
+    unsigned int timer;
+
+    if (!is_arbiter_handle(handle))
+        return arbiter_ops.release(handle);
+
+    pthread_mutex_lock(&arbiter_lock);
+    owner = find_owner(handle);
+    if (!owner) {
+        /* Already ran out. */
+        pthread_mutex_unlock(&arbiter_lock);
+        return 0;
+    }
+    timer = release_owner(owner);
+    pthread_mutex_unlock(&arbiter_lock);
+
+    if (timer != HINT_SCHED_INVALID)
+        hint_schedule_cancel(timer);
+
+    return 0;
+}
+
+static void expire_owner(void *arg)
+{
+    struct arbiter_owner *owner;
+
+    pthread_mutex_lock(&arbiter_lock);
+    owner = find_owner((int)(intptr_t)arg);
+    /* A renewal moves the deadline; its own timer will fire later. */
+    if (owner && owner->expires_ns && owner->expires_ns <= power_clock_now_ns())
+        release_owner(owner);
+    pthread_mutex_unlock(&arbiter_lock);
+}
+
+void perf_arbiter_dump(int fd)
+{
+    long long now;
+    int i, j;
+
+    pthread_mutex_lock(&arbiter_lock);
+    now = power_clock_now_ns();
+
+    dprintf(fd, "\nPerf arbiter: %llu lock(s) applied, %llu value(s) left unchanged\n",
+            num_applied, num_unchanged);
+    for (i = 0; i < PERF_ARBITER_MAX_OPCODES; i++) {
+        const struct arbiter_opcode *entry = &opcodes[i];
+
+        if (!entry->num_owners)
+            continue;
+
+        dprintf(fd, "  0x%08x %-6s effective=%d (0x%x) from 0x%x, lock %d\n",
+                entry->opcode, kind_names[perf_resource_kind(entry->opcode)],
+                entry->value, entry->value, entry->winner,
+                entry->lock >= 0 ? locks[entry->lock].handle : -1);
+
+        for (j = 0; j < PERF_ARBITER_MAX_OWNERS; j++) {
+            const struct arbiter_owner *owner = &owners[j];
+            const struct perf_resource *res;
+
+            if (!owner->handle || !(res = owner_resource(owner, entry->opcode)))
+                continue;
+
+            if (owner->expires_ns)
+                dprintf(fd, "      0x%x wants %d, %lldms left\n", owner->handle,
+                        res->value, (owner->expires_ns - now) / NSINMS);
+            else
+                dprintf(fd, "      0x%x wants %d\n", owner->handle, res->value);
+        }
+    }
+
+    pthread_mutex_unlock(&arbiter_lock);
+}
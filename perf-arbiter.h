@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERF_ARBITER_H
+#define _QCOM_POWER_PERF_ARBITER_H
+
+#define PERF_ARBITER_MAX_OWNERS 32
+/* Per owner, in resources (one legacy int or one v3 pair each). */
+#define PERF_ARBITER_MAX_RESOURCES 32
+/* Distinct opcodes held at once. */
+#define PERF_ARBITER_MAX_OPCODES 64
+
+/*
+ * Handles given out to owners. They sit below the batcher's handles and
+ * well above anything perfd hands out.
+ */
+#define PERF_ARBITER_HANDLE_BASE 0x20000000
+
+/* Where effective values are sent; one lock per recompute. */
+struct perf_arbiter_ops {
+    int (*acquire)(int handle, int duration, int list[], int num_args);
+    int (*release)(int handle);
+};
+
+void perf_arbiter_init(const struct perf_arbiter_ops *ops);
+
+/* Same contract as perf_lock_acq()/perf_lock_rel(). */
+int perf_arbiter_acquire(int handle, int duration, int list[], int num_args);
+int perf_arbiter_release(int handle);
+
+/* Writes every held resource, its effective value and its requesters. */
+void perf_arbiter_dump(int fd);
+
+#endif
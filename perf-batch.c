@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Merges perf lock requests that arrive within a short window into a
+ * single perfd lock.
+ *
+ * Every request becomes a member with its own handle, resources and
+ * expiry. A flush, run on the hint scheduler thread 'window' after the
+ * first unflushed change, folds all live members into one resource set
+ * (highest floor, lowest cap, union of flags) and holds exactly one
+ * perfd lock for it. When a member is released or runs out, the set is
+ * rebuilt without it; the new lock is taken before the old one is
+ * dropped, so shared resources never lapse. Requests that cannot be
+ * merged, because they disagree on an opaque resource, go straight to
+ * perfd.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <cutils/properties.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-scheduler.h"
+#include "perf-batch.h"
+#include "perf-resource.h"
+#include "power-clock.h"
+
+#define NSINUS 1000LL
+#define NSINMS 1000000LL
+
+struct batch_member {
+    int handle;                 /* 0 while free */
+    long long expires_ns;       /* 0 = held until released */
+    int num_resources;
+    struct perf_resource resources[PERF_BATCH_MAX_RESOURCES];
+};
+
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct perf_batch_ops batch_ops;
+static int window_us;
+static int next_id = 1;
+static struct batch_member members[PERF_BATCH_MAX_MEMBERS];
+
+/* Earliest pending flush; 0 if none. */
+static long long flush_deadline_ns;
+
+/* The perfd lock currently held for the merged set. */
+static int merged_handle;
+static long long merged_expires_ns;
+static int num_merged;
+static struct perf_resource merged[PERF_BATCH_MAX_MERGED];
+
+void perf_batch_init(const struct perf_batch_ops *ops)
+{
+    int window = property_get_int32(PERF_BATCH_WINDOW_PROP, 0);
+
+    if (window > 0)
+        perf_batch_setup(ops, window);
+}
+
+void perf_batch_setup(const struct perf_batch_ops *ops, int window)
+{
+    if (window > PERF_BATCH_MAX_WINDOW_US) {
+        ALOGE("%s=%d is above %dus, clamping", PERF_BATCH_WINDOW_PROP,
+                window, PERF_BATCH_MAX_WINDOW_US);
+        window = PERF_BATCH_MAX_WINDOW_US;
+    }
+
+    pthread_mutex_lock(&batch_lock);
+    batch_ops = *ops;
+    window_us = window > 0 ? window : 0;
+    pthread_mutex_unlock(&batch_lock);
+
+    if (window_us)
+        ALOGI("Batching perf locks within %dus", window_us);
+}
+
+bool perf_batch_enabled(void)
+{
+    return window_us > 0;
+}
+
+static bool is_batch_handle(int handle)
+{
+    return handle >= PERF_BATCH_HANDLE_BASE;
+}
+
+static struct batch_member *find_member(int handle)
+{
+    int i;
+
+    for (i = 0; i < PERF_BATCH_MAX_MEMBERS; i++) {
+        if (members[i].handle == handle)
+            return &members[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * Folds every live member except 'skip' into 'set'. Returns the set
+ * size, or a negative errno from perf_resource_merge().
+ */
+static int merge_members(struct perf_resource *set, const struct batch_member *skip)
+{
+    int num = 0;
+    int i, j, ret;
+
+    for (i = 0; i < PERF_BATCH_MAX_MEMBERS; i++) {
+        const struct batch_member *member = &members[i];
+
+        if (!member->handle || member == skip)
+            continue;
+        for (j = 0; j < member->num_resources; j++) {
+            ret = perf_resource_merge(set, &num, PERF_BATCH_MAX_MERGED,
+                    &member->resources[j]);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return num;
+}
+
+static int duration_ms(long long expires_ns, long long now)
+{
+    if (!expires_ns)
+        return 0;
+
+    /* Round up so the lock never ends before the member does. */
+    return (expires_ns - now + NSINMS - 1) / NSINMS;
+}
+
+static void flush(void *arg);
+
+/* Called with batch_lock held. */
+static void schedule_flush(long long deadline_ns, long long now)
+{
+    int delay_us;
+
+    if (flush_deadline_ns && flush_deadline_ns <= deadline_ns)
+        return;
+
+    delay_us = deadline_ns > now ? (deadline_ns - now + NSINUS - 1) / NSINUS : 0;
+    if (hint_schedule_call_us(delay_us, flush, NULL) == HINT_SCHED_INVALID) {
+        ALOGE("%s: unable to schedule perf lock flush", __func__);
+        return;
+    }
+    flush_deadline_ns = deadline_ns;
+}
+
+/* Called with batch_lock held. */
+static void rebuild(long long now)
+{
+    struct perf_resource set[PERF_BATCH_MAX_MERGED];
+    int list[PERF_BATCH_MAX_MERGED * 2];
+    long long expires_ns = 0, next_expiry = 0;
+    bool held_forever = false;
+    int num, num_args, handle, i;
+
+    for (i = 0; i < PERF_BATCH_MAX_MEMBERS; i++) {
+        struct batch_member *member = &members[i];
+
+        if (!member->handle)
+            continue;
+        if (member->expires_ns && member->expires_ns <= now) {
+            member->handle = 0;
+            continue;
+        }
+        if (!member->expires_ns)
+            held_forever = true;
+        else if (member->expires_ns > expires_ns)
+            expires_ns = member->expires_ns;
+    }
+    if (held_forever)
+        expires_ns = 0;
+
+    num = merge_members(set, NULL);
+    if (num < 0) {
+        /* Members are only admitted when they merge cleanly. */
+        ALOGE("%s: inconsistent members: %d", __func__, num);
+        return;
+    }
+
+    if (num == 0) {
+        if (merged_handle)
+            batch_ops.release(merged_handle);
+        merged_handle = 0;
+        num_merged = 0;
+        return;
+    }
+
+    num_args = perf_resource_encode(set, num, list, PERF_BATCH_MAX_MERGED * 2);
+    if (num_args < 0)
+        return;
+
+    if (merged_handle && perf_resource_set_equal(set, num, merged, num_merged)) {
+        /* Same resources: only move the end of the lock, if needed. */
+        if (expires_ns != merged_expires_ns) {
+            handle = batch_ops.acquire(merged_handle, duration_ms(expires_ns, now),
+                    list, num_args);
+            if (handle != -1) {
+                merged_handle = handle;
+                merged_expires_ns = expires_ns;
+            }
+        }
+    } else {
+        /* Take the new lock before dropping the old one. */
+        handle = batch_ops.acquire(0, duration_ms(expires_ns, now), list, num_args);
+        if (handle == -1) {
+            ALOGE("%s: failed to acquire merged lock", __func__);
+            return;
+        }
+        if (merged_handle)
+            batch_ops.release(merged_handle);
+        merged_handle = handle;
+        merged_expires_ns = expires_ns;
+        memcpy(merged, set, num * sizeof(set[0]));
+        num_merged = num;
+    }
+
+    /* Rebuild again when a member runs out before the merged lock does. */
+    for (i = 0; i < PERF_BATCH_MAX_MEMBERS; i++) {
+        const struct batch_member *member = &members[i];
+
+        if (member->handle && member->expires_ns &&
+                (!merged_expires_ns || member->expires_ns < merged_expires_ns) &&
+                (!next_expiry || member->expires_ns < next_expiry))
+            next_expiry = member->expires_ns;
+    }
+    if (next_expiry)
+        schedule_flush(next_expiry, now);
+}
+
+static void flush(void *arg)
+{
+    long long now;
+
+    (void)arg;
+
+    pthread_mutex_lock(&batch_lock);
+    now = power_clock_now_ns();
+    if (flush_deadline_ns <= now)
+        flush_deadline_ns = 0;
+    rebuild(now);
+    pthread_mutex_unlock(&batch_lock);
+}
+
+/*
+ * Called with batch_lock held, when the renewal of 'member' goes
+ * straight to perfd instead: its old request must not linger in the set.
+ */
+static void drop_member(struct batch_member *member, long long now)
+{
+    member->handle = 0;
+    schedule_flush(now, now);
+}
+
+int perf_batch_acquire(int handle, int duration, int list[], int num_args)
+{
+    struct perf_resource resources[PERF_BATCH_MAX_RESOURCES];
+    struct perf_resource set[PERF_BATCH_MAX_MERGED];
+    struct batch_member *member = NULL;
+    long long now;
+    int num, num_set, i;
+
+    num = perf_resource_parse(list, num_args, resources, PERF_BATCH_MAX_RESOURCES);
+    if (num <= 0) {
+        if (is_batch_handle(handle)) {
+            pthread_mutex_lock(&batch_lock);
+            member = find_member(handle);
+            if (member)
+                drop_member(member, power_clock_now_ns());
+            pthread_mutex_unlock(&batch_lock);
+        }
+        goto direct;
+    }
+
+    pthread_mutex_lock(&batch_lock);
+    now = power_clock_now_ns();
+
+    if (is_batch_handle(handle))
+        member = find_member(handle);
+
+    /* Admit the request only if it merges cleanly with the others. */
+    num_set = merge_members(set, member);
+    for (i = 0; i < num && num_set >= 0; i++) {
+        int ret = perf_resource_merge(set, &num_set, PERF_BATCH_MAX_MERGED,
+                &resources[i]);
+        if (ret < 0)
+            num_set = ret;
+    }
+    if (num_set < 0) {
+        if (member)
+            drop_member(member, now);
+        pthread_mutex_unlock(&batch_lock);
+        goto direct;
+    }
+
+    if (!member)
+        member = find_member(0);
+    if (!member) {
+        pthread_mutex_unlock(&batch_lock);
+        ALOGV("%s: too many batched requests", __func__);
+        goto direct;
+    }
+
+    if (!member->handle) {
+        member->handle = PERF_BATCH_HANDLE_BASE + next_id;
+        next_id = next_id < PERF_BATCH_HANDLE_BASE - 1 ? next_id + 1 : 1;
+    }
+    member->expires_ns = duration ? now + duration * NSINMS : 0;
+    member->num_resources = num;
+    memcpy(member->resources, resources, num * sizeof(resources[0]));
+    handle = member->handle;
+
+    schedule_flush(now + window_us * NSINUS, now);
+    pthread_mutex_unlock(&batch_lock);
+
+    return handle;
+
+direct:
+    return batch_ops.acquire(is_batch_handle(handle) ? 0 : handle, duration,
+            list, num_args);
+}
+
+int perf_batch_release(int handle)
+{
+    struct batch_member *member;
+    long long now;
+
+    if (!is_batch_handle(handle))
+        return batch_ops.release(handle);
+
+    pthread_mutex_lock(&batch_lock);
+    member = find_member(handle);
+    if (!member) {
+        /* Already ran out. */
+        pthread_mutex_unlock(&batch_lock);
+        return 0;
+    }
+
+    member->handle = 0;
+    now = power_clock_now_ns();
+    schedule_flush(now + window_us * NSINUS, now);
+    pthread_mutex_unlock(&batch_lock);
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERF_BATCH_H
+#define _QCOM_POWER_PERF_BATCH_H
+
+#include <stdbool.h>
+
+#define PERF_BATCH_WINDOW_PROP "vendor.power.batch_window_us"
+#define PERF_BATCH_MAX_WINDOW_US 1000
+
+#define PERF_BATCH_MAX_MEMBERS 16
+/* Per member, in resources (one legacy int or one v3 pair each). */
+#define PERF_BATCH_MAX_RESOURCES 32
+#define PERF_BATCH_MAX_MERGED 64
+
+/*
+ * Handles given out for batched requests. perfd hands out small
+ * positive integers, so the two never collide.
+ */
+#define PERF_BATCH_HANDLE_BASE 0x40000000
+
+/* How the batcher reaches perfd. */
+struct perf_batch_ops {
+    int (*acquire)(unsigned long handle, int duration, int list[], int num_args);
+    int (*release)(unsigned long handle);
+};
+
+/* Reads the window from PERF_BATCH_WINDOW_PROP. */
+void perf_batch_init(const struct perf_batch_ops *ops);
+/* Batches within 'window' us; 0 turns batching off. Tests call this directly. */
+void perf_batch_setup(const struct perf_batch_ops *ops, int window);
+bool perf_batch_enabled(void);
+
+/* Same contract as perf_lock_acq()/perf_lock_rel(). */
+int perf_batch_acquire(int handle, int duration, int list[], int num_args);
+int perf_batch_release(int handle);
+
+#endif
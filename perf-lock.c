@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "perf-lock.h"
+#include "utils.h"
+
+int perf_lock_hint(struct perf_lock *lock, int hint_id, int duration, int type)
+{
+    int handle;
+
+    if (perf_lock_held(lock) && lock->kind == PERF_LOCK_HINT &&
+            lock->hint_id == hint_id && lock->hint_type == type &&
+            lock->duration == 0 && duration == 0)
+        return 0;
+
+    handle = perf_hint_enable_with_type(hint_id, duration, type);
+    if (handle <= 0)
+        return -EINVAL;
+
+    /* Only now that the new lock is held can the old one go. */
+    if (perf_lock_held(lock) && lock->handle != handle)
+        release_request(lock->handle);
+
+    lock->handle = handle;
+    lock->kind = PERF_LOCK_HINT;
+    lock->duration = duration;
+    lock->hint_id = hint_id;
+    lock->hint_type = type;
+
+    return 0;
+}
+
+int perf_lock_acquire(struct perf_lock *lock, int duration,
+        const int resources[], int num_resources)
+{
+    int resource_values[PERF_LOCK_MAX_RESOURCES];
+    int renew = 0, handle;
+
+    if (num_resources < 1 || num_resources > PERF_LOCK_MAX_RESOURCES)
+        return -EINVAL;
+
+    /* A resource lock is renewed in place by passing its handle back. */
+    if (perf_lock_held(lock) && lock->kind == PERF_LOCK_RESOURCES)
+        renew = lock->handle;
+
+    memcpy(resource_values, resources, num_resources * sizeof(int));
+    handle = interaction_with_handle(renew, duration, num_resources,
+            resource_values);
+    if (handle <= 0)
+        return -EINVAL;
+
+    if (perf_lock_held(lock) && lock->handle != handle)
+        release_request(lock->handle);
+
+    lock->handle = handle;
+    lock->kind = PERF_LOCK_RESOURCES;
+    lock->duration = duration;
+    memcpy(lock->resources, resources, num_resources * sizeof(int));
+    lock->num_resources = num_resources;
+
+    return 0;
+}
+
+int perf_lock_extend(struct perf_lock *lock, int duration)
+{
+    struct perf_lock prev = *lock;
+
+    switch (lock->kind) {
+        case PERF_LOCK_HINT:
+            /* Force a fresh request even for an indefinite hint. */
+            lock->duration = -1;
+            if (perf_lock_hint(lock, prev.hint_id, duration, prev.hint_type)) {
+                lock->duration = prev.duration;
+                return -EINVAL;
+            }
+            return 0;
+        case PERF_LOCK_RESOURCES:
+            return perf_lock_acquire(lock, duration, prev.resources,
+                    prev.num_resources);
+        default:
+            return -ENOENT;
+    }
+}
+
+int perf_lock_renew(struct perf_lock *lock)
+{
+    return perf_lock_extend(lock, lock->duration);
+}
+
+void perf_lock_release(struct perf_lock *lock)
+{
+    if (perf_lock_held(lock))
+        release_request(lock->handle);
+    lock->handle = 0;
+    lock->kind = PERF_LOCK_NONE;
+}
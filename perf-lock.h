@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERF_LOCK_H
+#define _QCOM_POWER_PERF_LOCK_H
+
+#include <stdbool.h>
+
+/* Enough for any boost profile. */
+#define PERF_LOCK_MAX_RESOURCES 64
+
+enum perf_lock_kind {
+    PERF_LOCK_NONE,
+    PERF_LOCK_HINT,             /* perf_hint() */
+    PERF_LOCK_RESOURCES,        /* perf_lock_acq() through the arbiter */
+};
+
+/*
+ * One perf lock and the request behind it, so it can be renewed or
+ * extended later. Taking a new request on a held lock replaces it,
+ * new lock first, so a handle is never dropped on the floor. Callers
+ * serialize access to a given lock.
+ */
+struct perf_lock {
+    int handle;                 /* > 0 while held */
+    enum perf_lock_kind kind;
+    int duration;               /* ms; 0 holds until released */
+    int hint_id;
+    int hint_type;
+    int resources[PERF_LOCK_MAX_RESOURCES];
+    int num_resources;
+};
+
+#define PERF_LOCK_INIT { .handle = 0 }
+
+/*
+ * Holds perf hint 'hint_id' of 'type' (-1 for none) for 'duration' ms.
+ * Asking again for the same indefinite hint keeps the lock as is.
+ * Returns 0, or -errno with any previous lock still held.
+ */
+int perf_lock_hint(struct perf_lock *lock, int hint_id, int duration, int type);
+
+/*
+ * Holds 'resources' for 'duration' ms. A held resource lock is renewed
+ * in place rather than stacked. Returns 0 or -errno.
+ */
+int perf_lock_acquire(struct perf_lock *lock, int duration,
+        const int resources[], int num_resources);
+
+/* Re-issues the last request for its original duration. */
+int perf_lock_renew(struct perf_lock *lock);
+
+/* Re-issues the last request for 'duration' ms from now. */
+int perf_lock_extend(struct perf_lock *lock, int duration);
+
+void perf_lock_release(struct perf_lock *lock);
+
+static inline bool perf_lock_held(const struct perf_lock *lock)
+{
+    return lock->handle > 0;
+}
+
+#endif
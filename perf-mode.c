@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <stdint.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-client.h"
+#include "hint-stats.h"
+#include "perf-mode.h"
+#include "power-common.h"
+#include "utils.h"
+
+static int mode_hint_id(const struct perf_mode_engine *engine, unsigned int modes)
+{
+    int i;
+
+    for (i = 0; i < engine->num_entries; i++) {
+        if (engine->table[i].modes == modes)
+            return engine->table[i].hint_id;
+    }
+
+    return 0;
+}
+
+/*
+ * Moves to the hint for the modes with 'mode' turned on or off. Called
+ * with engine->lock held. Returns HINT_HANDLED or HINT_NONE.
+ */
+static int switch_modes(struct perf_mode_engine *engine, unsigned int mode, int enable)
+{
+    unsigned int current, next;
+    int hint_id;
+
+    current = atomic_load(&engine->current);
+    next = enable ? current | mode : current & ~mode;
+    if (next == current) {
+        ALOGD("Mode 0x%x already %s", mode, enable ? "enabled" : "disabled");
+        hint_stats_note(HINT_OUTCOME_SUPPRESSED);
+        return HINT_HANDLED;
+    }
+
+    hint_id = mode_hint_id(engine, next);
+    if (hint_id == mode_hint_id(engine, current)) {
+        /* Both modes map to the same hint; keep the lock already held. */
+        atomic_store(&engine->current, next);
+        ALOGI("Current mode is 0x%x", next);
+        hint_stats_note(HINT_OUTCOME_HANDLED);
+        return HINT_HANDLED;
+    }
+
+    if (hint_id) {
+        /* Takes the new hint before the old one is released. */
+        if (perf_lock_hint(&engine->held, hint_id, 0, -1)) {
+            ALOGE("Couldn't %s mode 0x%x", enable ? "enable" : "disable", mode);
+            hint_stats_note(HINT_OUTCOME_ERROR);
+            return HINT_NONE;
+        }
+    } else {
+        perf_lock_release(&engine->held);
+    }
+
+    atomic_store(&engine->current, next);
+    ALOGI("Current mode is 0x%x", next);
+    hint_stats_note(HINT_OUTCOME_HANDLED);
+
+    return HINT_HANDLED;
+}
+
+static struct hint_client_holder *mode_holder(struct perf_mode_engine *engine,
+        unsigned int mode)
+{
+    return &engine->holders[__builtin_ctz(mode)];
+}
+
+/* Turns off a mode whose client died, unless someone turned it on since. */
+static void release_client_mode(void *owner, unsigned long mode,
+        struct hint_client_holder dead)
+{
+    struct perf_mode_engine *engine = owner;
+
+    pthread_mutex_lock(&engine->lock);
+    if ((atomic_load(&engine->current) & mode) &&
+            hint_client_same_holder(*mode_holder(engine, mode), dead))
+        switch_modes(engine, mode, 0);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+int perf_mode_set(struct perf_mode_engine *engine, unsigned int mode, int enable)
+{
+    struct hint_client_holder holder = { { 0, 0 }, 0 };
+    int ret;
+
+    if (!mode)
+        return HINT_NONE;
+    if (enable)
+        holder = hint_client_current_holder();
+
+    pthread_mutex_lock(&engine->lock);
+    ret = switch_modes(engine, mode, enable);
+    if (ret == HINT_HANDLED)
+        *mode_holder(engine, mode) = holder;
+    pthread_mutex_unlock(&engine->lock);
+
+    /* Attributes 'mode' to the caller while it is on. */
+    if (ret == HINT_HANDLED) {
+        if (enable)
+            hint_client_track(engine, mode, holder, "mode", release_client_mode);
+        else
+            hint_client_untrack(engine, mode);
+    }
+
+    return ret;
+}
+
+int perf_mode_hint(struct perf_mode_engine *engine, unsigned int mode, void *data)
+{
+    if (!data)
+        return HINT_NONE;
+
+    return perf_mode_set(engine, mode, *(int32_t *)data);
+}
+
+unsigned int perf_mode_current(struct perf_mode_engine *engine)
+{
+    return atomic_load(&engine->current);
+}
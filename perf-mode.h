@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERF_MODE_H
+#define _QCOM_POWER_PERF_MODE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "hint-client.h"
+#include "perf-lock.h"
+
+/* Long-lived modes. Each is one bit; any combination may be active. */
+enum perf_mode {
+    PERF_MODE_NORMAL    = 0,
+    PERF_MODE_SUSTAINED = 1 << 0,
+    PERF_MODE_VR        = 1 << 1,
+    PERF_MODE_LOW_POWER = 1 << 2,
+    PERF_MODE_CAMERA    = 1 << 3,
+    PERF_MODE_GAMING    = 1 << 4,
+};
+
+#define PERF_MODE_BITS 5
+
+/*
+ * The perf_hint() id held while exactly 'modes' are active. A
+ * combination without a row holds nothing.
+ */
+struct perf_mode_hint {
+    unsigned int modes;
+    int hint_id;
+};
+
+struct perf_mode_engine {
+    const struct perf_mode_hint *table;
+    int num_entries;
+    pthread_mutex_t lock;       /* serializes switches */
+    atomic_uint current;
+    struct perf_lock held;      /* hint for the current modes */
+    struct hint_client_holder holders[PERF_MODE_BITS]; /* who turned each on */
+};
+
+#define PERF_MODE_ENGINE_INIT(tbl) \
+    { .table = (tbl), .num_entries = ARRAY_SIZE(tbl), \
+      .lock = PTHREAD_MUTEX_INITIALIZER, .held = PERF_LOCK_INIT }
+
+/*
+ * Turns 'mode', a single PERF_MODE_* bit, on or off, moving to the
+ * hint for the resulting combination. The new hint is taken before the
+ * old one is released, nothing is touched when both combinations map
+ * to the same hint, and a failed switch leaves the engine where it
+ * was. Returns HINT_HANDLED or HINT_NONE.
+ */
+int perf_mode_set(struct perf_mode_engine *engine, unsigned int mode, int enable);
+
+/* perf_mode_set() driven by a power hint's int32 on/off argument. */
+int perf_mode_hint(struct perf_mode_engine *engine, unsigned int mode, void *data);
+
+unsigned int perf_mode_current(struct perf_mode_engine *engine);
+
+#endif
@@ -0,0 +1,550 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-scheduler.h"
+#include "perf-native.h"
+#include "perf-resource.h"
+#include "performance.h"
+#include "power-clock.h"
+#include "utils.h"
+
+#define NSINMS 1000000LL
+
+#define NODE_PATH_SIZE 128
+#define NODE_VALUE_SIZE 64
+#define MAX_CPUS 8
+
+#define CPUFREQ_NODE "/sys/devices/system/cpu/cpu%d/cpufreq/%s"
+#define CORE_CTL_NODE "/sys/devices/system/cpu/cpu%d/core_ctl/%s"
+#define SCHED_BOOST_NODE "/proc/sys/kernel/sched_boost"
+#define KGSL_NODE "/sys/class/kgsl/kgsl-3d0/%s"
+#define CPUBW_NODE "/sys/class/devfreq/soc:qcom,cpubw/%s"
+#define GPUBW_NODE "/sys/class/devfreq/soc:qcom,gpubw/%s"
+
+/* Frequency levels that mean "the highest the CPU supports". */
+#define LEGACY_FREQ_MAX_LEVEL 0xFE
+#define V3_FREQ_MAX_LEVEL 0xFFF
+/* Legacy levels are in units of 100MHz, v3 values in MHz. */
+#define LEGACY_FREQ_UNIT_KHZ 100000
+#define V3_FREQ_UNIT_KHZ 1000
+#define GPU_FREQ_UNIT_HZ 1000000
+
+/* v3 opcodes select the cluster in bits 8-11: 0 is big, 1 is little. */
+#define V3_CLUSTER(opcode) (((opcode) >> 8) & 0xF)
+#define V3_RESIDX 0x2000
+
+struct native_node {
+    char path[NODE_PATH_SIZE];          /* "" while free */
+    enum perf_resource_kind kind;
+    int users;
+    long long value;                    /* last value written */
+    char saved[NODE_VALUE_SIZE];        /* restored when users drops to 0 */
+};
+
+struct native_request {
+    int node;
+    long long value;
+};
+
+struct native_lock {
+    int handle;                         /* 0 while free */
+    unsigned long long seq;             /* the newest opaque value wins */
+    long long expires_ns;               /* 0 = held until released */
+    unsigned int timer;
+    int num_requests;
+    struct native_request requests[PERF_NATIVE_MAX_RESOURCES];
+};
+
+static pthread_mutex_t native_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char native_root[NODE_PATH_SIZE / 2];
+static bool native_root_set;
+static struct native_node nodes[PERF_NATIVE_MAX_NODES];
+static struct native_lock locks[PERF_NATIVE_MAX_LOCKS];
+static int next_handle = 1;
+static unsigned long long next_seq;
+
+static bool topology_loaded;
+static int big_cpu;
+static int big_cluster_size = 1;
+
+int perf_native_init(const char *root)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&native_mutex);
+    /* A truncated root would send writes somewhere else entirely. */
+    native_root_set = strlen(root) < sizeof(native_root);
+    if (native_root_set) {
+        strcpy(native_root, root);
+    } else {
+        ALOGE("%s: root %s is too long", __func__, root);
+        ret = -ENAMETOOLONG;
+    }
+    topology_loaded = false;
+    pthread_mutex_unlock(&native_mutex);
+
+    return ret;
+}
+
+static int node_path(char *path, const char *fmt, ...)
+{
+    va_list args;
+    int len;
+
+    len = snprintf(path, NODE_PATH_SIZE, "%s", native_root);
+    va_start(args, fmt);
+    len += vsnprintf(path + len, NODE_PATH_SIZE - len, fmt, args);
+    va_end(args);
+
+    return len < NODE_PATH_SIZE ? 0 : -ENAMETOOLONG;
+}
+
+/*
+ * The big cluster is the cpufreq policy whose first CPU is the highest;
+ * the little cluster always starts at cpu0.
+ */
+static void load_topology(void)
+{
+    char path[NODE_PATH_SIZE];
+    char buf[64];
+    int cpu;
+
+    big_cpu = 0;
+    big_cluster_size = 1;
+
+    for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+        char *token, *saveptr;
+        int first, count = 0;
+
+        if (node_path(path, CPUFREQ_NODE, cpu, "related_cpus") ||
+                sysfs_read(path, buf, sizeof(buf)))
+            continue;
+
+        first = atoi(buf);
+        for (token = strtok_r(buf, " \n", &saveptr); token;
+                token = strtok_r(NULL, " \n", &saveptr))
+            count++;
+
+        if (first > big_cpu || (first == 0 && big_cpu == 0)) {
+            big_cpu = first;
+            big_cluster_size = count ? count : 1;
+        }
+        cpu = first + count - 1 > cpu ? first + count - 1 : cpu;
+    }
+
+    topology_loaded = true;
+}
+
+static int read_number(const char *path, long long *value)
+{
+    char buf[NODE_VALUE_SIZE];
+
+    if (sysfs_read(path, buf, sizeof(buf)))
+        return -EIO;
+
+    *value = strtoll(buf, NULL, 0);
+    return 0;
+}
+
+/* 'khz' < 0 selects cpuinfo_max_freq. */
+static int cpu_freq(char *path, long long *value, int cpu, const char *node,
+        long long khz)
+{
+    if (khz < 0) {
+        if (node_path(path, CPUFREQ_NODE, cpu, "cpuinfo_max_freq") ||
+                read_number(path, value))
+            return -EIO;
+    } else {
+        *value = khz;
+    }
+
+    return node_path(path, CPUFREQ_NODE, cpu, node);
+}
+
+static long long legacy_khz(int level)
+{
+    return level >= LEGACY_FREQ_MAX_LEVEL ? -1 : (long long)level * LEGACY_FREQ_UNIT_KHZ;
+}
+
+static long long v3_khz(int value)
+{
+    return value >= V3_FREQ_MAX_LEVEL ? -1 : (long long)value * V3_FREQ_UNIT_KHZ;
+}
+
+static int resolve_legacy(const struct perf_resource *res, char *path,
+        long long *value)
+{
+    uint32_t rr = res->opcode;
+    int level = res->value;
+
+    if (rr >= 0x02 && rr <= 0x05)
+        return cpu_freq(path, value, rr - 0x02, "scaling_min_freq", legacy_khz(level));
+    if (rr >= 0x1F && rr <= 0x22)
+        return cpu_freq(path, value, rr - 0x1F + 4, "scaling_min_freq", legacy_khz(level));
+    if (rr >= 0x15 && rr <= 0x18)
+        return cpu_freq(path, value, rr - 0x15, "scaling_max_freq", legacy_khz(level));
+    if (rr >= 0x23 && rr <= 0x26)
+        return cpu_freq(path, value, rr - 0x23 + 4, "scaling_max_freq", legacy_khz(level));
+
+    switch (rr) {
+        case 0x07:      /* CPUS_ONLINE_MIN_*: 0x77 and up mean all */
+            *value = level >= 0x77 ? big_cluster_size : level;
+            if (*value > big_cluster_size)
+                *value = big_cluster_size;
+            return node_path(path, CORE_CTL_NODE, big_cpu, "min_cpus");
+        case 0x1E:      /* SCHED_BOOST_ON */
+            *value = level;
+            return node_path(path, SCHED_BOOST_NODE);
+        default:
+            return -ENOTSUP;
+    }
+}
+
+static int resolve_v3(const struct perf_resource *res, char *path,
+        long long *value)
+{
+    uint32_t opcode = res->opcode;
+    int cpu = V3_CLUSTER(opcode) ? 0 : big_cpu;
+
+    if (opcode & V3_RESIDX)
+        return -ENOTSUP;
+
+    switch (opcode & 0xFFFFC000u) {
+        case MIN_FREQ_BIG_CORE_0:
+            return cpu_freq(path, value, cpu, "scaling_min_freq", v3_khz(res->value));
+        case MAX_FREQ_BIG_CORE_0:
+            return cpu_freq(path, value, cpu, "scaling_max_freq", v3_khz(res->value));
+        case CPUS_ONLINE_MIN_BIG:
+            *value = res->value;
+            return node_path(path, CORE_CTL_NODE, cpu, "min_cpus");
+        case CPUS_ONLINE_MAX_BIG:
+            *value = res->value;
+            return node_path(path, CORE_CTL_NODE, cpu, "max_cpus");
+        case SCHED_BOOST_ON_V3:
+            *value = res->value;
+            return node_path(path, SCHED_BOOST_NODE);
+        case CPUBW_HWMON_MIN_FREQ:
+            *value = res->value;
+            return node_path(path, CPUBW_NODE, "min_freq");
+        case GPU_MIN_POWER_LEVEL:
+            *value = res->value;
+            return node_path(path, KGSL_NODE, "min_pwrlevel");
+        case GPU_MAX_POWER_LEVEL:
+            *value = res->value;
+            return node_path(path, KGSL_NODE, "max_pwrlevel");
+        case GPU_MIN_FREQ:
+            *value = (long long)res->value * GPU_FREQ_UNIT_HZ;
+            return node_path(path, KGSL_NODE, "devfreq/min_freq");
+        case GPU_MAX_FREQ:
+            *value = (long long)res->value * GPU_FREQ_UNIT_HZ;
+            return node_path(path, KGSL_NODE, "devfreq/max_freq");
+        case GPUBW_MIN_FREQ:
+            *value = res->value;
+            return node_path(path, GPUBW_NODE, "min_freq");
+        case GPUBW_MAX_FREQ:
+            *value = res->value;
+            return node_path(path, GPUBW_NODE, "max_freq");
+        default:
+            return -ENOTSUP;
+    }
+}
+
+/* Returns the node for 'path', saving its value on first use, or -1. */
+static int get_node(const char *path, enum perf_resource_kind kind)
+{
+    struct native_node *node;
+    int i, free_slot = -1;
+
+    for (i = 0; i < PERF_NATIVE_MAX_NODES; i++) {
+        if (!nodes[i].path[0]) {
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (!strcmp(nodes[i].path, path)) {
+            return i;
+        }
+    }
+
+    if (free_slot < 0) {
+        ALOGE("%s: too many nodes", __func__);
+        return -1;
+    }
+
+    node = &nodes[free_slot];
+    if (sysfs_read(path, node->saved, sizeof(node->saved)))
+        return -1;
+
+    strcpy(node->path, path);
+    node->kind = kind;
+    node->users = 0;
+    node->value = strtoll(node->saved, NULL, 0);
+
+    return free_slot;
+}
+
+/*
+ * Recomputes what 'index' should hold from every lock using it and
+ * writes it if it changed. A node nobody uses gets its saved value back
+ * and its slot is freed.
+ */
+static void apply_node(int index)
+{
+    struct native_node *node = &nodes[index];
+    unsigned long long newest = 0;
+    long long value = 0;
+    bool found = false;
+    char buf[NODE_VALUE_SIZE];
+    int i, j;
+
+    /* Already restored through an earlier request for the same node. */
+    if (!node->path[0])
+        return;
+
+    if (!node->users) {
+        if (sysfs_write(node->path, node->saved))
+            ALOGE("%s: failed to restore %s", __func__, node->path);
+        node->path[0] = '\0';
+        return;
+    }
+
+    for (i = 0; i < PERF_NATIVE_MAX_LOCKS; i++) {
+        const struct native_lock *lock = &locks[i];
+
+        if (!lock->handle)
+            continue;
+
+        for (j = 0; j < lock->num_requests; j++) {
+            long long v = lock->requests[j].value;
+
+            if (lock->requests[j].node != index)
+                continue;
+
+            if (!found) {
+                value = v;
+            } else {
+                switch (node->kind) {
+                    case PERF_RESOURCE_FLOOR:
+                        value = v > value ? v : value;
+                        break;
+                    case PERF_RESOURCE_CAP:
+                        value = v < value ? v : value;
+                        break;
+                    case PERF_RESOURCE_FLAG:
+                        value |= v;
+                        break;
+                    default:
+                        if (lock->seq > newest)
+                            value = v;
+                        break;
+                }
+            }
+            if (lock->seq > newest)
+                newest = lock->seq;
+            found = true;
+        }
+    }
+
+    if (value == node->value)
+        return;
+
+    snprintf(buf, sizeof(buf), "%lld", value);
+    if (sysfs_write(node->path, buf)) {
+        ALOGE("%s: failed to write %s", __func__, node->path);
+        return;
+    }
+    node->value = value;
+}
+
+/* Drops every request of 'lock'; nodes are left for the caller to apply. */
+static void clear_requests(struct native_lock *lock)
+{
+    int i;
+
+    for (i = 0; i < lock->num_requests; i++)
+        nodes[lock->requests[i].node].users--;
+}
+
+static void apply_requests(const struct native_request *requests, int num)
+{
+    int i;
+
+    for (i = 0; i < num; i++)
+        apply_node(requests[i].node);
+}
+
+static void expire_lock(void *arg);
+
+int perf_native_acquire(unsigned long handle, int duration, int list[], int num_args)
+{
+    struct perf_resource resources[PERF_NATIVE_MAX_RESOURCES];
+    struct native_request old[PERF_NATIVE_MAX_RESOURCES];
+    struct native_lock *lock = NULL;
+    unsigned int old_timer = HINT_SCHED_INVALID;
+    int num, num_old, ret, i;
+
+    if (duration < 0)
+        return -1;
+
+    num = perf_resource_parse(list, num_args, resources, PERF_NATIVE_MAX_RESOURCES);
+    if (num < 0)
+        return -1;
+
+    pthread_mutex_lock(&native_mutex);
+
+    if (!native_root_set) {
+        pthread_mutex_unlock(&native_mutex);
+        return -1;
+    }
+
+    if (!topology_loaded)
+        load_topology();
+
+    for (i = 0; i < PERF_NATIVE_MAX_LOCKS && handle; i++) {
+        if (locks[i].handle == (int)handle) {
+            lock = &locks[i];
+            break;
+        }
+    }
+    for (i = 0; i < PERF_NATIVE_MAX_LOCKS && !lock; i++) {
+        if (!locks[i].handle) {
+            lock = &locks[i];
+            lock->handle = next_handle;
+            next_handle = next_handle < INT32_MAX ? next_handle + 1 : 1;
+        }
+    }
+    if (!lock) {
+        pthread_mutex_unlock(&native_mutex);
+        ALOGE("%s: too many locks", __func__);
+        return -1;
+    }
+
+    /* Renewing: the old requests are re-applied once the new ones are in. */
+    clear_requests(lock);
+    num_old = lock->num_requests;
+    memcpy(old, lock->requests, num_old * sizeof(old[0]));
+
+    lock->seq = ++next_seq;
+    lock->num_requests = 0;
+    for (i = 0; i < num; i++) {
+        struct native_request *request = &lock->requests[lock->num_requests];
+        char path[NODE_PATH_SIZE];
+
+        ret = resources[i].opcode & PERF_RESOURCE_V3_BASE ?
+                resolve_v3(&resources[i], path, &request->value) :
+                resolve_legacy(&resources[i], path, &request->value);
+        if (ret) {
+            ALOGV("%s: skipping resource 0x%x: %d", __func__,
+                    resources[i].opcode, ret);
+            continue;
+        }
+
+        request->node = get_node(path, perf_resource_kind(resources[i].opcode));
+        if (request->node < 0)
+            continue;
+        nodes[request->node].users++;
+        lock->num_requests++;
+    }
+
+    apply_requests(lock->requests, lock->num_requests);
+    apply_requests(old, num_old);
+
+    old_timer = lock->timer;
+    lock->timer = HINT_SCHED_INVALID;
+    lock->expires_ns = 0;
+    if (duration) {
+        lock->expires_ns = power_clock_now_ns() + duration * NSINMS;
+        lock->timer = hint_schedule_call(duration, expire_lock,
+                (void *)(intptr_t)lock->handle);
+    }
+    handle = lock->handle;
+
+    pthread_mutex_unlock(&native_mutex);
+
+    /* Outside the mutex: a running expire_lock() may be waiting for it. */
+    if (old_timer != HINT_SCHED_INVALID)
+        hint_schedule_cancel(old_timer);
+
+    return handle;
+}
+
+/* Called with native_mutex held. Returns the timer left to cancel. */
+static unsigned int release_locked(struct native_lock *lock)
+{
+    unsigned int timer = lock->timer;
+
+    clear_requests(lock);
+    lock->handle = 0;
+    lock->timer = HINT_SCHED_INVALID;
+    apply_requests(lock->requests, lock->num_requests);
+    lock->num_requests = 0;
+
+    return timer;
+}
+
+int perf_native_release(unsigned long handle)
+{
+    unsigned int timer = HINT_SCHED_INVALID;
+    int ret = -1;
+    int i;
+
+    pthread_mutex_lock(&native_mutex);
+    for (i = 0; i < PERF_NATIVE_MAX_LOCKS && handle; i++) {
+        if (locks[i].handle == (int)handle) {
+            timer = release_locked(&locks[i]);
+            ret = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&native_mutex);
+
+    if (timer != HINT_SCHED_INVALID)
+        hint_schedule_cancel(timer);
+
+    return ret;
+}
+
+static void expire_lock(void *arg)
+{
+    int handle = (int)(intptr_t)arg;
+    int i;
+
+    pthread_mutex_lock(&native_mutex);
+    for (i = 0; i < PERF_NATIVE_MAX_LOCKS; i++) {
+        struct native_lock *lock = &locks[i];
+
+        /* A renewal moves the deadline; its own timer will fire later. */
+        if (lock->handle == handle && lock->expires_ns &&
+                lock->expires_ns <= power_clock_now_ns()) {
+            release_locked(lock);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&native_mutex);
+}
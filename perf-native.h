@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERF_NATIVE_H
+#define _QCOM_POWER_PERF_NATIVE_H
+
+/* Prefix for every node the backend touches; tests point it elsewhere. */
+#define PERF_NATIVE_ROOT ""
+
+#define PERF_NATIVE_MAX_LOCKS 32
+#define PERF_NATIVE_MAX_NODES 48
+#define PERF_NATIVE_MAX_RESOURCES 32
+
+/*
+ * Applies perf lock resources straight to cpufreq, core_ctl, sched,
+ * devfreq and kgsl nodes, for builds without libqti-perfd-client.
+ * Overlapping locks are aggregated per node (highest floor, lowest cap,
+ * union of flags, newest opaque value) and each node gets its original
+ * value back when the last lock using it goes away.
+ *
+ * Returns -ENAMETOOLONG if 'root' doesn't fit, in which case every
+ * acquire fails until a valid root is set.
+ */
+int perf_native_init(const char *root);
+
+/* Same contract as perf_lock_acq()/perf_lock_rel(). */
+int perf_native_acquire(unsigned long handle, int duration, int list[], int num_args);
+int perf_native_release(unsigned long handle);
+
+#endif
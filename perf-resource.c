@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "perf-resource.h"
+#include "power-common.h"
+
+/* Strips the cluster/core (bits 8-11) and RESIDX (bit 13) fields. */
+#define V3_RESOURCE_MASK 0xFFFFC000u
+
+struct opcode_kind {
+    uint32_t opcode;
+    enum perf_resource_kind kind;
+};
+
+/* Legacy resources, by the RR byte of 0xRRVV. Everything else is opaque. */
+static const struct opcode_kind legacy_kinds[] = {
+    { 0x02, PERF_RESOURCE_FLOOR },  /* CPU0-3 min freq */
+    { 0x03, PERF_RESOURCE_FLOOR },
+    { 0x04, PERF_RESOURCE_FLOOR },
+    { 0x05, PERF_RESOURCE_FLOOR },
+    { 0x07, PERF_RESOURCE_FLOOR },  /* min CPUs online */
+    { 0x14, PERF_RESOURCE_FLAG },   /* THREAD_MIGRATION_SYNC_OFF */
+    { 0x15, PERF_RESOURCE_CAP },    /* CPU0-3 max freq */
+    { 0x16, PERF_RESOURCE_CAP },
+    { 0x17, PERF_RESOURCE_CAP },
+    { 0x18, PERF_RESOURCE_CAP },
+    { 0x1E, PERF_RESOURCE_FLAG },   /* SCHED_BOOST_ON */
+    { 0x1F, PERF_RESOURCE_FLOOR },  /* CPU4-7 min freq */
+    { 0x20, PERF_RESOURCE_FLOOR },
+    { 0x21, PERF_RESOURCE_FLOOR },
+    { 0x22, PERF_RESOURCE_FLOOR },
+    { 0x23, PERF_RESOURCE_CAP },    /* CPU4-7 max freq */
+    { 0x24, PERF_RESOURCE_CAP },
+    { 0x25, PERF_RESOURCE_CAP },
+    { 0x26, PERF_RESOURCE_CAP },
+    { 0x3E, PERF_RESOURCE_FLAG },   /* SCHED_PREFER_IDLE_DIS */
+};
+
+/* v3 resources, after V3_RESOURCE_MASK. */
+static const struct opcode_kind v3_kinds[] = {
+    { 0x40400000, PERF_RESOURCE_FLAG },     /* ALL_CPUS_PWR_CLPS_DIS_V3 */
+    { 0x40800000, PERF_RESOURCE_FLOOR },    /* MIN_FREQ_* */
+    { 0x40804000, PERF_RESOURCE_CAP },      /* MAX_FREQ_* */
+    { 0x40C00000, PERF_RESOURCE_FLOOR },    /* SCHED_BOOST_ON_V3, a level */
+    { 0x40C04000, PERF_RESOURCE_FLAG },     /* SCHED_PREFER_IDLE_DIS_V3 */
+    { 0x41000000, PERF_RESOURCE_FLOOR },    /* CPUS_ONLINE_MIN_* */
+    { 0x41004000, PERF_RESOURCE_CAP },      /* CPUS_ONLINE_MAX_* */
+    { 0x41800000, PERF_RESOURCE_FLOOR },    /* CPUBW_HWMON_MIN_FREQ */
+    { 0x4280C000, PERF_RESOURCE_FLOOR },    /* GPU_MIN_FREQ */
+    { 0x42810000, PERF_RESOURCE_CAP },      /* GPU_MAX_FREQ */
+    { 0x42814000, PERF_RESOURCE_FLOOR },    /* GPUBW_MIN_FREQ */
+    { 0x42818000, PERF_RESOURCE_CAP },      /* GPUBW_MAX_FREQ */
+};
+
+static enum perf_resource_kind lookup_kind(const struct opcode_kind *table,
+        unsigned int size, uint32_t opcode)
+{
+    unsigned int i;
+
+    for (i = 0; i < size; i++) {
+        if (table[i].opcode == opcode)
+            return table[i].kind;
+    }
+
+    return PERF_RESOURCE_OPAQUE;
+}
+
+enum perf_resource_kind perf_resource_kind(uint32_t opcode)
+{
+    if (opcode & PERF_RESOURCE_V3_BASE)
+        return lookup_kind(v3_kinds, ARRAY_SIZE(v3_kinds),
+                opcode & V3_RESOURCE_MASK);
+
+    return lookup_kind(legacy_kinds, ARRAY_SIZE(legacy_kinds), opcode);
+}
+
+/*
+ * Splits a perf lock argument list into resources. Returns how many
+ * were stored, -EINVAL if a v3 opcode lacks its value or -ENOSPC if
+ * 'resources' is too small.
+ */
+int perf_resource_parse(const int *list, int num_args,
+        struct perf_resource *resources, int max_resources)
+{
+    int count = 0;
+    int i = 0;
+
+    while (i < num_args) {
+        uint32_t arg = (uint32_t)list[i];
+
+        if (count == max_resources)
+            return -ENOSPC;
+
+        if (arg & PERF_RESOURCE_V3_BASE) {
+            if (i + 1 >= num_args)
+                return -EINVAL;
+            resources[count].opcode = arg;
+            resources[count].value = list[i + 1];
+            i += 2;
+        } else {
+            resources[count].opcode = arg >> 8;
+            resources[count].value = arg & 0xFF;
+            i++;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+/*
+ * Inverse of perf_resource_parse(). Returns the number of ints written
+ * to 'list', or -ENOSPC.
+ */
+int perf_resource_encode(const struct perf_resource *resources,
+        int num_resources, int *list, int max_args)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < num_resources; i++) {
+        const struct perf_resource *res = &resources[i];
+
+        if (res->opcode & PERF_RESOURCE_V3_BASE) {
+            if (count + 2 > max_args)
+                return -ENOSPC;
+            list[count++] = res->opcode;
+            list[count++] = res->value;
+        } else {
+            if (count + 1 > max_args)
+                return -ENOSPC;
+            list[count++] = (res->opcode << 8) | (res->value & 0xFF);
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Folds 'resource' into 'set'. Returns 1 if the set changed, 0 if it
+ * already covered the request, -EEXIST if an opaque resource is
+ * already held at another value and -ENOSPC if the set is full.
+ */
+int perf_resource_merge(struct perf_resource *set, int *num_resources,
+        int max_resources, const struct perf_resource *resource)
+{
+    struct perf_resource *held = NULL;
+    int32_t value;
+    int i;
+
+    for (i = 0; i < *num_resources; i++) {
+        if (set[i].opcode == resource->opcode) {
+            held = &set[i];
+            break;
+        }
+    }
+
+    if (!held) {
+        if (*num_resources == max_resources)
+            return -ENOSPC;
+        set[(*num_resources)++] = *resource;
+        return 1;
+    }
+
+    switch (perf_resource_kind(resource->opcode)) {
+        case PERF_RESOURCE_FLOOR:
+            value = held->value > resource->value ? held->value : resource->value;
+            break;
+        case PERF_RESOURCE_CAP:
+            value = held->value < resource->value ? held->value : resource->value;
+            break;
+        case PERF_RESOURCE_FLAG:
+            value = held->value | resource->value;
+            break;
+        default:
+            if (held->value != resource->value)
+                return -EEXIST;
+            value = held->value;
+            break;
+    }
+
+    if (value == held->value)
+        return 0;
+
+    held->value = value;
+    return 1;
+}
+
+/* Returns 1 if both sets hold the same resources, in any order. */
+int perf_resource_set_equal(const struct perf_resource *a, int num_a,
+        const struct perf_resource *b, int num_b)
+{
+    int i, j;
+
+    if (num_a != num_b)
+        return 0;
+
+    for (i = 0; i < num_a; i++) {
+        bool found = false;
+
+        for (j = 0; j < num_b; j++) {
+            if (a[i].opcode == b[j].opcode) {
+                found = a[i].value == b[j].value;
+                break;
+            }
+        }
+        if (!found)
+            return 0;
+    }
+
+    return 1;
+}
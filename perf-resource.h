@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_PERF_RESOURCE_H
+#define _QCOM_POWER_PERF_RESOURCE_H
+
+#include <stdint.h>
+
+/* MPCTL v3 opcodes have bit 30 set and are followed by their value. */
+#define PERF_RESOURCE_V3_BASE 0x40000000u
+
+enum perf_resource_kind {
+    PERF_RESOURCE_OPAQUE,   /* requests must agree on the value */
+    PERF_RESOURCE_FLOOR,    /* the highest value wins */
+    PERF_RESOURCE_CAP,      /* the lowest value wins */
+    PERF_RESOURCE_FLAG,     /* set if any request sets it */
+};
+
+/*
+ * One entry of a perf lock argument list. Legacy entries are a single
+ * int, 0xRRVV: 'opcode' holds the resource RR and 'value' the level VV.
+ * v3 entries are an (opcode, value) pair.
+ */
+struct perf_resource {
+    uint32_t opcode;
+    int32_t value;
+};
+
+enum perf_resource_kind perf_resource_kind(uint32_t opcode);
+
+int perf_resource_parse(const int *list, int num_args,
+        struct perf_resource *resources, int max_resources);
+int perf_resource_encode(const struct perf_resource *resources,
+        int num_resources, int *list, int max_args);
+int perf_resource_merge(struct perf_resource *set, int *num_resources,
+        int max_resources, const struct perf_resource *resource);
+int perf_resource_set_equal(const struct perf_resource *a, int num_a,
+        const struct perf_resource *b, int num_b);
+
+#endif
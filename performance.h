@@ -41,6 +41,17 @@ extern "C" {
  */
 #define VENDOR_HINT_DISPLAY_OFF      0x00001040
 #define VENDOR_HINT_DISPLAY_ON       0x00001041
+#define VENDOR_HINT_SCROLL_BOOST     0x00001080
+#define VENDOR_HINT_FIRST_LAUNCH_BOOST 0x00001081
+
+enum SCROLL_TYPE {
+    SCROLL_VERTICAL = 1,
+    SCROLL_HORIZONTAL = 2,
+};
+
+enum LAUNCH_BOOST_TYPE {
+    LAUNCH_BOOST_V1 = 1,
+};
 
 enum SCREEN_DISPLAY_TYPE {
     DISPLAY_OFF = 0x00FF,
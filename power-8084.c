@@ -43,6 +43,7 @@
 #include <hardware/hardware.h>
 #include <hardware/power.h>
 
+#include "boost-engine.h"
 #include "utils.h"
 #include "metadata-defs.h"
 #include "hint-data.h"
@@ -78,53 +79,51 @@ static int resources_launch[] = {
     CPU3_MIN_FREQ_NONTURBO_MAX + 5
 };
 
-const int DEFAULT_INTERACTIVE_DURATION   =  200; /* ms */
-const int MIN_FLING_DURATION             = 1500; /* ms */
-const int MAX_INTERACTIVE_DURATION       = 5000; /* ms */
-const int LAUNCH_DURATION                = 2000; /* ms */
+#define DEFAULT_INTERACTIVE_DURATION    200 /* ms */
+#define MIN_FLING_DURATION             1500 /* ms */
+#define MAX_INTERACTIVE_DURATION       5000 /* ms */
+#define LAUNCH_DURATION                2000 /* ms */
+
+static const struct boost_tier interaction_tiers[] = {
+    BOOST_TIER(MIN_FLING_DURATION, BOOST_PROFILE_FLING,
+            resources_interaction_fling_boost),
+    BOOST_TIER(0, BOOST_PROFILE_INTERACTION, resources_interaction_boost),
+};
+
+static const struct boost_config interaction_config = {
+    .name = "interaction",
+    .default_duration = DEFAULT_INTERACTIVE_DURATION,
+    .min_duration = DEFAULT_INTERACTIVE_DURATION,
+    .max_duration = MAX_INTERACTIVE_DURATION,
+    .coalesce = 1,
+    .tiers = interaction_tiers,
+    .num_tiers = ARRAY_SIZE(interaction_tiers),
+};
+
+static struct boost_engine interaction_boost = BOOST_ENGINE_INIT(&interaction_config);
+
+static const struct boost_tier launch_tiers[] = {
+    BOOST_TIER(0, BOOST_PROFILE_LAUNCH, resources_launch),
+};
+
+static const struct boost_config launch_config = {
+    .name = "launch",
+    .default_duration = LAUNCH_DURATION,
+    .min_duration = LAUNCH_DURATION,
+    .max_duration = LAUNCH_DURATION,
+    .tiers = launch_tiers,
+    .num_tiers = ARRAY_SIZE(launch_tiers),
+};
+
+static struct boost_engine launch_boost = BOOST_ENGINE_INIT(&launch_config);
 
 int power_hint_override(power_hint_t hint, void *data)
 {
-    static struct timespec s_previous_boost_timespec;
-    struct timespec cur_boost_timespec;
-    long long elapsed_time;
-    static int s_previous_duration = 0;
-    int duration;
-
     switch (hint) {
         case POWER_HINT_INTERACTION:
-            duration = DEFAULT_INTERACTIVE_DURATION;
-            if (data) {
-                int input_duration = *((int*)data);
-                if (input_duration > duration) {
-                    duration = (input_duration > MAX_INTERACTIVE_DURATION) ?
-                            MAX_INTERACTIVE_DURATION : input_duration;
-                }
-            }
-
-            clock_gettime(CLOCK_MONOTONIC, &cur_boost_timespec);
-
-            elapsed_time = calc_timespan_us(s_previous_boost_timespec, cur_boost_timespec);
-            // don't hint if previous hint's duration covers this hint's duration
-            if ((s_previous_duration * 1000) > (elapsed_time + duration * 1000)) {
-                return HINT_HANDLED;
-            }
-            s_previous_boost_timespec = cur_boost_timespec;
-            s_previous_duration = duration;
-
-            if (duration >= MIN_FLING_DURATION) {
-                interaction(duration, ARRAY_SIZE(resources_interaction_fling_boost),
-                        resources_interaction_fling_boost);
-            } else {
-                interaction(duration, ARRAY_SIZE(resources_interaction_boost),
-                        resources_interaction_boost);
-            }
-            return HINT_HANDLED;
+            return boost_engine_hint(&interaction_boost, data);
         case POWER_HINT_LAUNCH:
-            duration = LAUNCH_DURATION;
-            interaction(duration, ARRAY_SIZE(resources_launch),
-                    resources_launch);
-            return HINT_HANDLED;
+            return boost_engine_boost(&launch_boost, LAUNCH_DURATION);
         default:
             break;
     }
@@ -150,27 +149,25 @@ int set_interactive_override(int on)
             undo_initial_hint_action();
             first_display_off_hint = 1;
         }
-        /* Used for all subsequent toggles to the display */
-        undo_hint_action(DISPLAY_STATE_HINT_ID_2);
 
         if (is_ondemand_governor(governor)) {
             int resource_values[] = {
                 MS_500, SYNC_FREQ_600, OPTIMAL_FREQ_600, THREAD_MIGRATION_SYNC_OFF
             };
-            perform_hint_action(DISPLAY_STATE_HINT_ID,
+            /* Hold the display-off lock before dropping the display-on one. */
+            transition_hint_action(DISPLAY_STATE_HINT_ID_2, DISPLAY_STATE_HINT_ID,
                     resource_values, ARRAY_SIZE(resource_values));
+        } else {
+            /* Used for all subsequent toggles to the display */
+            undo_hint_action(DISPLAY_STATE_HINT_ID_2);
         }
     } else {
         /* Display on */
         int resource_values2[] = {
             CPUS_ONLINE_MIN_2
         };
-        perform_hint_action(DISPLAY_STATE_HINT_ID_2,
+        transition_hint_action(DISPLAY_STATE_HINT_ID, DISPLAY_STATE_HINT_ID_2,
                 resource_values2, ARRAY_SIZE(resource_values2));
-
-        if (is_ondemand_governor(governor)) {
-            undo_hint_action(DISPLAY_STATE_HINT_ID);
-        }
     }
     return HINT_HANDLED;
 }
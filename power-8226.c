@@ -43,6 +43,7 @@
 #include <hardware/hardware.h>
 #include <hardware/power.h>
 
+#include "boost-engine.h"
 #include "utils.h"
 #include "metadata-defs.h"
 #include "hint-data.h"
@@ -55,37 +56,27 @@ static int resources_interaction_boost[] = {
     0x30B
 };
 
+static const struct boost_tier interaction_tiers[] = {
+    BOOST_TIER(0, BOOST_PROFILE_INTERACTION, resources_interaction_boost),
+};
+
+static const struct boost_config interaction_config = {
+    .name = "interaction",
+    .default_duration = 500,
+    .min_duration = 500,
+    .max_duration = 5000,
+    .coalesce = 1,
+    .tiers = interaction_tiers,
+    .num_tiers = ARRAY_SIZE(interaction_tiers),
+};
+
+static struct boost_engine interaction_boost = BOOST_ENGINE_INIT(&interaction_config);
+
 int power_hint_override(power_hint_t hint, void *data)
 {
-    static struct timespec s_previous_boost_timespec;
-    struct timespec cur_boost_timespec;
-    long long elapsed_time;
-    static int s_previous_duration = 0;
-    int duration;
-
     switch (hint) {
         case POWER_HINT_INTERACTION:
-            duration = 500; // 500ms by default
-            if (data) {
-                int input_duration = *((int*)data);
-                if (input_duration > duration) {
-                    duration = (input_duration > 5000) ? 5000 : input_duration;
-                }
-            }
-
-            clock_gettime(CLOCK_MONOTONIC, &cur_boost_timespec);
-
-            elapsed_time = calc_timespan_us(s_previous_boost_timespec, cur_boost_timespec);
-            // don't hint if previous hint's duration covers this hint's duration
-            if ((s_previous_duration * 1000) > (elapsed_time + duration * 1000)) {
-                return HINT_HANDLED;
-            }
-            s_previous_boost_timespec = cur_boost_timespec;
-            s_previous_duration = duration;
-
-            interaction(duration, ARRAY_SIZE(resources_interaction_boost),
-                    resources_interaction_boost);
-            return HINT_HANDLED;
+            return boost_engine_hint(&interaction_boost, data);
         default:
             break;
     }
@@ -44,15 +44,33 @@
 #include <hardware/hardware.h>
 #include <hardware/power.h>
 
+#include "boost-engine.h"
 #include "utils.h"
 #include "metadata-defs.h"
 #include "hint-data.h"
+#include "perf-lock.h"
 #include "performance.h"
 #include "power-common.h"
 
-const int kMaxLaunchDuration = 5000; /* ms */
-const int kMaxInteractiveDuration = 5000; /* ms */
-const int kMinInteractiveDuration = 500; /* ms */
+#define MAX_LAUNCH_DURATION      5000 /* ms */
+#define MAX_INTERACTIVE_DURATION 5000 /* ms */
+#define MIN_INTERACTIVE_DURATION  500 /* ms */
+
+static const struct boost_tier interaction_tiers[] = {
+    BOOST_TIER_VENDOR(0, VENDOR_HINT_SCROLL_BOOST, SCROLL_VERTICAL),
+};
+
+static const struct boost_config interaction_config = {
+    .name = "interaction",
+    .default_duration = MIN_INTERACTIVE_DURATION,
+    .min_duration = MIN_INTERACTIVE_DURATION,
+    .max_duration = MAX_INTERACTIVE_DURATION,
+    .coalesce = 1,
+    .tiers = interaction_tiers,
+    .num_tiers = ARRAY_SIZE(interaction_tiers),
+};
+
+static struct boost_engine interaction_boost = BOOST_ENGINE_INIT(&interaction_config);
 
 static int video_encode_hint_sent;
 
@@ -113,23 +131,19 @@ static void process_video_encode_hint(void *metadata)
 
 static int process_activity_launch_hint(void *data)
 {
-    static int launch_handle = -1;
+    static struct perf_lock launch_lock = PERF_LOCK_INIT;
     static int launch_mode = 0;
 
     // release lock early if launch has finished
     if (!data) {
-        if (CHECK_HANDLE(launch_handle)) {
-            release_request(launch_handle);
-            launch_handle = -1;
-        }
+        perf_lock_release(&launch_lock);
         launch_mode = 0;
         return HINT_HANDLED;
     }
 
     if (!launch_mode) {
-        launch_handle = perf_hint_enable_with_type(VENDOR_HINT_FIRST_LAUNCH_BOOST,
-                kMaxLaunchDuration, LAUNCH_BOOST_V1);
-        if (!CHECK_HANDLE(launch_handle)) {
+        if (perf_lock_hint(&launch_lock, VENDOR_HINT_FIRST_LAUNCH_BOOST,
+                MAX_LAUNCH_DURATION, LAUNCH_BOOST_V1)) {
             ALOGE("Failed to perform launch boost");
             return HINT_NONE;
         }
@@ -138,36 +152,6 @@ static int process_activity_launch_hint(void *data)
     return HINT_HANDLED;
 }
 
-static void process_interaction_hint(void *data)
-{
-    static struct timespec s_previous_boost_timespec;
-    static int s_previous_duration = 0;
-
-    struct timespec cur_boost_timespec;
-    long long elapsed_time;
-    int duration = kMinInteractiveDuration;
-
-    if (data) {
-        int input_duration = *((int*)data);
-        if (input_duration > duration) {
-            duration = (input_duration > kMaxInteractiveDuration) ?
-                    kMaxInteractiveDuration : input_duration;
-        }
-    }
-
-    clock_gettime(CLOCK_MONOTONIC, &cur_boost_timespec);
-
-    elapsed_time = calc_timespan_us(s_previous_boost_timespec, cur_boost_timespec);
-    // don't hint if previous hint's duration covers this hint's duration
-    if ((s_previous_duration * 1000) > (elapsed_time + duration * 1000)) {
-        return;
-    }
-    s_previous_boost_timespec = cur_boost_timespec;
-    s_previous_duration = duration;
-
-    perf_hint_enable_with_type(VENDOR_HINT_SCROLL_BOOST, duration, SCROLL_VERTICAL);
-}
-
 int power_hint_override(power_hint_t hint, void *data)
 {
     switch (hint) {
@@ -175,8 +159,7 @@ int power_hint_override(power_hint_t hint, void *data)
             process_video_encode_hint(data);
             return HINT_HANDLED;
         case POWER_HINT_INTERACTION:
-            process_interaction_hint(data);
-            return HINT_HANDLED;
+            return boost_engine_hint(&interaction_boost, data);
         case POWER_HINT_LAUNCH:
             return process_activity_launch_hint(data);
         default:
@@ -44,6 +44,7 @@
 #include <hardware/hardware.h>
 #include <hardware/power.h>
 
+#include "boost-engine.h"
 #include "utils.h"
 #include "metadata-defs.h"
 #include "hint-data.h"
@@ -93,47 +94,46 @@ static int resources_launch[] = {
     CPU3_MIN_FREQ_TURBO_MAX
 };
 
+static const struct boost_tier interaction_tiers[] = {
+    BOOST_TIER(1500, BOOST_PROFILE_FLING,
+            resources_interaction_fling_boost),
+    BOOST_TIER(0, BOOST_PROFILE_INTERACTION, resources_interaction_boost),
+};
+
+static const struct boost_config interaction_config = {
+    .name = "interaction",
+    .default_duration = 500,
+    .min_duration = 500,
+    .max_duration = 5000,
+    .coalesce = 1,
+    .tiers = interaction_tiers,
+    .num_tiers = ARRAY_SIZE(interaction_tiers),
+};
+
+static struct boost_engine interaction_boost = BOOST_ENGINE_INIT(&interaction_config);
+
+static const struct boost_tier launch_tiers[] = {
+    BOOST_TIER(0, BOOST_PROFILE_LAUNCH, resources_launch),
+};
+
+static const struct boost_config launch_config = {
+    .name = "launch",
+    .default_duration = 2000,
+    .min_duration = 2000,
+    .max_duration = 2000,
+    .tiers = launch_tiers,
+    .num_tiers = ARRAY_SIZE(launch_tiers),
+};
+
+static struct boost_engine launch_boost = BOOST_ENGINE_INIT(&launch_config);
+
 int power_hint_override(power_hint_t hint, void *data)
 {
-    static struct timespec s_previous_boost_timespec;
-    struct timespec cur_boost_timespec;
-    long long elapsed_time;
-    static int s_previous_duration = 0;
-    int duration;
-
     switch (hint) {
         case POWER_HINT_INTERACTION:
-            duration = 500; // 500ms by default
-            if (data) {
-                int input_duration = *((int*)data);
-                if (input_duration > duration) {
-                    duration = (input_duration > 5000) ? 5000 : input_duration;
-                }
-            }
-
-            clock_gettime(CLOCK_MONOTONIC, &cur_boost_timespec);
-
-            elapsed_time = calc_timespan_us(s_previous_boost_timespec, cur_boost_timespec);
-            // don't hint if previous hint's duration covers this hint's duration
-            if ((s_previous_duration * 1000) > (elapsed_time + duration * 1000)) {
-                return HINT_HANDLED;
-            }
-            s_previous_boost_timespec = cur_boost_timespec;
-            s_previous_duration = duration;
-
-            if (duration >= 1500) {
-                interaction(duration, ARRAY_SIZE(resources_interaction_fling_boost),
-                        resources_interaction_fling_boost);
-            } else {
-                interaction(duration, ARRAY_SIZE(resources_interaction_boost),
-                        resources_interaction_boost);
-            }
-            return HINT_HANDLED;
+            return boost_engine_hint(&interaction_boost, data);
         case POWER_HINT_LAUNCH:
-            duration = 2000;
-            interaction(duration, ARRAY_SIZE(resources_launch),
-                    resources_launch);
-            return HINT_HANDLED;
+            return boost_engine_boost(&launch_boost, 2000);
         default:
             break;
     }
@@ -155,21 +155,21 @@ int set_interactive_override(int on)
          * We need to be able to identify the first display off hint
          * and release the current lock holder
          */
-        if (is_target_8974pro()) {
-            if (!first_display_off_hint) {
-                undo_initial_hint_action();
-                first_display_off_hint = 1;
-            }
-            /* used for all subsequent toggles to the display */
-            undo_hint_action(DISPLAY_STATE_HINT_ID_2);
+        if (is_target_8974pro() && !first_display_off_hint) {
+            undo_initial_hint_action();
+            first_display_off_hint = 1;
         }
 
         if (is_ondemand_governor(governor)) {
             int resource_values[] = {
                 MS_500, SYNC_FREQ_600, OPTIMAL_FREQ_600, THREAD_MIGRATION_SYNC_OFF
             };
-            perform_hint_action(DISPLAY_STATE_HINT_ID,
+            /* Hold the display-off lock before dropping the display-on one. */
+            transition_hint_action(DISPLAY_STATE_HINT_ID_2, DISPLAY_STATE_HINT_ID,
                     resource_values, ARRAY_SIZE(resource_values));
+        } else if (is_target_8974pro()) {
+            /* used for all subsequent toggles to the display */
+            undo_hint_action(DISPLAY_STATE_HINT_ID_2);
         }
     } else {
         /* Display on */
@@ -177,11 +177,9 @@ int set_interactive_override(int on)
             int resource_values2[] = {
                 CPUS_ONLINE_MIN_2
             };
-            perform_hint_action(DISPLAY_STATE_HINT_ID_2,
+            transition_hint_action(DISPLAY_STATE_HINT_ID, DISPLAY_STATE_HINT_ID_2,
                     resource_values2, ARRAY_SIZE(resource_values2));
-        }
-
-        if (is_ondemand_governor(governor)) {
+        } else if (is_ondemand_governor(governor)) {
             undo_hint_action(DISPLAY_STATE_HINT_ID);
         }
     }
@@ -45,55 +45,31 @@
 #include <hardware/hardware.h>
 #include <hardware/power.h>
 
+#include "boost-engine.h"
+#include "hint-scheduler.h"
 #include "utils.h"
 #include "metadata-defs.h"
 #include "hint-data.h"
 #include "performance.h"
 #include "power-common.h"
 
-pthread_mutex_t video_encode_lock = PTHREAD_MUTEX_INITIALIZER;
-uintptr_t video_encode_hint_counter = 0;
-bool video_encode_hint_should_enable = false;
-bool video_encode_hint_is_enabled = false;
+#define VIDEO_ENCODE_DELAY_MS 2000
 
-static int new_hint_id = DEFAULT_VIDEO_ENCODE_HINT_ID;
+static pthread_mutex_t video_encode_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int video_encode_job = HINT_SCHED_INVALID;
+static bool video_encode_hint_is_enabled = false;
 static int cur_hint_id = DEFAULT_VIDEO_ENCODE_HINT_ID;
 
-static const time_t VIDEO_ENCODE_DELAY_SECONDS = 2;
-static const time_t VIDEO_ENCODE_DELAY_NSECONDS = 0;
-
-static void* video_encode_hint_function(void* arg) {
-    struct timespec tv = {0};
-    tv.tv_sec = VIDEO_ENCODE_DELAY_SECONDS;
-    tv.tv_nsec = VIDEO_ENCODE_DELAY_NSECONDS;
-    int nanosleep_ret = 0;
-    uintptr_t expected_counter = (uintptr_t)arg;
-
-    // delay the hint for two seconds
-    // the hint hotplugs the large CPUs, so this prevents the large CPUs from
-    // going offline until the camera has had time to startup
-    TEMP_FAILURE_RETRY(nanosleep(&tv, &tv));
-    pthread_mutex_lock(&video_encode_lock);
-
-    // check to ensure we should still turn on hint from this particular thread
-    // if should_enable is true but counter is different, another thread owns hint
-    // if should_enable is false, we've already quit the camera
-    if (video_encode_hint_should_enable == true && video_encode_hint_counter == expected_counter) {
-        /* sched and cpufreq params
-         * A57 - offlines
-         * A53 - 4 cores online at 1.2GHz
-         */
-        int resource_values[] = {0x150C, 0x160C, 0x170C, 0x180C, 0x3DFF};
-
-        perform_hint_action(new_hint_id,
-                            resource_values, sizeof(resource_values)/sizeof(resource_values[0]));
-        cur_hint_id = new_hint_id;
+/*
+ * Cancels the pending delayed hint, noting whether it already ran.
+ * Called with video_encode_lock held.
+ */
+static void cancel_video_encode_job(void)
+{
+    if (hint_schedule_cancel(video_encode_job) != 0 &&
+            video_encode_job != HINT_SCHED_INVALID)
         video_encode_hint_is_enabled = true;
-        video_encode_hint_should_enable = false;
-    }
-
-    pthread_mutex_unlock(&video_encode_lock);
-    return NULL;
+    video_encode_job = HINT_SCHED_INVALID;
 }
 
 static void process_video_encode_hint(void *metadata)
@@ -123,28 +99,30 @@ static void process_video_encode_hint(void *metadata)
 
     if (video_encode_metadata.state == 1) {
         if (is_interactive_governor(governor)) {
-	     pthread_t video_encode_hint_thread;
-             pthread_mutex_lock(&video_encode_lock);
-             new_hint_id = video_encode_metadata.hint_id;
-             if (video_encode_hint_counter < 65535) {
-            	                video_encode_hint_counter++;
-            } else {
-	        video_encode_hint_counter = 0;
-	            }
-            // start new thread to launch hint
-            video_encode_hint_should_enable = true;
-            if (pthread_create(&video_encode_hint_thread, NULL, video_encode_hint_function, (void*)video_encode_hint_counter) != 0) {
-                ALOGE("Error constructing hint thread");
-                video_encode_hint_should_enable = false;
-                pthread_mutex_unlock(&video_encode_lock);
-                return HINT_NONE;
-            }
-            pthread_detach(video_encode_hint_thread);
+            /* sched and cpufreq params
+             * A57 - offlines
+             * A53 - 4 cores online at 1.2GHz
+             */
+            int resource_values[] = {0x150C, 0x160C, 0x170C, 0x180C, 0x3DFF};
+
+            pthread_mutex_lock(&video_encode_lock);
+            cancel_video_encode_job();
+            // delay the hint for two seconds
+            // the hint hotplugs the large CPUs, so this prevents the large CPUs from
+            // going offline until the camera has had time to startup
+            video_encode_job = hint_schedule_perform(VIDEO_ENCODE_DELAY_MS,
+                    video_encode_metadata.hint_id,
+                    resource_values, ARRAY_SIZE(resource_values));
+            if (video_encode_job == HINT_SCHED_INVALID)
+                ALOGE("Error scheduling video encode hint");
+            else
+                cur_hint_id = video_encode_metadata.hint_id;
             pthread_mutex_unlock(&video_encode_lock);
+        }
     } else if (video_encode_metadata.state == 0) {
         if (is_interactive_governor(governor)) {
-           pthread_mutex_lock(&video_encode_lock);
-            video_encode_hint_should_enable = false;
+            pthread_mutex_lock(&video_encode_lock);
+            cancel_video_encode_job();
             if (video_encode_hint_is_enabled == true) {
                 undo_hint_action(cur_hint_id);
                 video_encode_hint_is_enabled = false;
@@ -170,47 +148,46 @@ static int resources_launch[] = {
     0x20C
 };
 
+static const struct boost_tier interaction_tiers[] = {
+    BOOST_TIER(1500, BOOST_PROFILE_FLING,
+            resources_interaction_fling_boost),
+    BOOST_TIER(0, BOOST_PROFILE_INTERACTION, resources_interaction_boost),
+};
+
+static const struct boost_config interaction_config = {
+    .name = "interaction",
+    .default_duration = 500,
+    .min_duration = 500,
+    .max_duration = 5000,
+    .coalesce = 1,
+    .tiers = interaction_tiers,
+    .num_tiers = ARRAY_SIZE(interaction_tiers),
+};
+
+static struct boost_engine interaction_boost = BOOST_ENGINE_INIT(&interaction_config);
+
+static const struct boost_tier launch_tiers[] = {
+    BOOST_TIER(0, BOOST_PROFILE_LAUNCH, resources_launch),
+};
+
+static const struct boost_config launch_config = {
+    .name = "launch",
+    .default_duration = 2000,
+    .min_duration = 2000,
+    .max_duration = 2000,
+    .tiers = launch_tiers,
+    .num_tiers = ARRAY_SIZE(launch_tiers),
+};
+
+static struct boost_engine launch_boost = BOOST_ENGINE_INIT(&launch_config);
+
 int power_hint_override(power_hint_t hint, void *data)
 {
-    static struct timespec s_previous_boost_timespec;
-    struct timespec cur_boost_timespec;
-    long long elapsed_time;
-    static int s_previous_duration = 0;
-    int duration;
-
     switch (hint) {
         case POWER_HINT_INTERACTION:
-            duration = 500; // 500ms by default
-            if (data) {
-                int input_duration = *((int*)data);
-                if (input_duration > duration) {
-                    duration = (input_duration > 5000) ? 5000 : input_duration;
-                }
-            }
-
-            clock_gettime(CLOCK_MONOTONIC, &cur_boost_timespec);
-
-            elapsed_time = calc_timespan_us(s_previous_boost_timespec, cur_boost_timespec);
-            // don't hint if previous hint's duration covers this hint's duration
-            if ((s_previous_duration * 1000) > (elapsed_time + duration * 1000)) {
-                return HINT_HANDLED;
-            }
-            s_previous_boost_timespec = cur_boost_timespec;
-            s_previous_duration = duration;
-
-            if (duration >= 1500) {
-                interaction(duration, ARRAY_SIZE(resources_interaction_fling_boost),
-                        resources_interaction_fling_boost);
-            } else {
-                interaction(duration, ARRAY_SIZE(resources_interaction_boost),
-                        resources_interaction_boost);
-            }
-            return HINT_HANDLED;
+            return boost_engine_hint(&interaction_boost, data);
         case POWER_HINT_LAUNCH:
-            duration = 2000;
-            interaction(duration, ARRAY_SIZE(resources_launch),
-                    resources_launch);
-            return HINT_HANDLED;
+            return boost_engine_boost(&launch_boost, 2000);
         case POWER_HINT_VIDEO_ENCODE:
             process_video_encode_hint(data);
             return HINT_HANDLED;
@@ -233,7 +210,7 @@ int set_interactive_override(int on)
         /* Display off */
         if (is_interactive_governor(governor)) {
             int resource_values[] = {0x41004000, 0x0}; /* 4+0 core config in display off */
-            };
+
             perform_hint_action(DISPLAY_STATE_HINT_ID,
                     resource_values, ARRAY_SIZE(resource_values));
         }
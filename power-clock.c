@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <time.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "hint-scheduler.h"
+#include "power-clock.h"
+
+#define NSINSEC 1000000000LL
+
+static bool simulated;
+static long long simulated_ns;
+
+long long power_clock_now_ns(void)
+{
+    struct timespec ts;
+
+    if (__builtin_expect(simulated, 0))
+        return __atomic_load_n(&simulated_ns, __ATOMIC_ACQUIRE);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSINSEC + ts.tv_nsec;
+}
+
+void power_clock_sleep_until(long long deadline_ns)
+{
+    struct timespec ts;
+
+    if (simulated) {
+        power_clock_advance_to(deadline_ns);
+        return;
+    }
+
+    ts.tv_sec = deadline_ns / NSINSEC;
+    ts.tv_nsec = deadline_ns % NSINSEC;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+void power_clock_simulate(long long start_ns)
+{
+    __atomic_store_n(&simulated_ns, start_ns > 0 ? start_ns : 1, __ATOMIC_RELEASE);
+    simulated = true;
+    ALOGI("Using a simulated clock");
+}
+
+bool power_clock_simulated(void)
+{
+    return simulated;
+}
+
+static void set_simulated(long long now_ns)
+{
+    if (now_ns > __atomic_load_n(&simulated_ns, __ATOMIC_RELAXED))
+        __atomic_store_n(&simulated_ns, now_ns, __ATOMIC_RELEASE);
+}
+
+void power_clock_advance_to(long long target_ns)
+{
+    long long deadline;
+
+    if (!simulated) {
+        ALOGE("%s: the clock is not simulated", __func__);
+        return;
+    }
+
+    /* Timers scheduled by the ones that fire are picked up as well. */
+    while ((deadline = hint_schedule_next_deadline()) && deadline <= target_ns) {
+        set_simulated(deadline);
+        hint_schedule_run_due();
+    }
+    set_simulated(target_ns);
+}
+
+void power_clock_advance(long long delta_ns)
+{
+    power_clock_advance_to(power_clock_now_ns() + delta_ns);
+}
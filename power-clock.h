@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_CLOCK_H
+#define _QCOM_POWER_CLOCK_H
+
+#include <stdbool.h>
+
+/*
+ * The time base for every boost timing decision: coalescing windows,
+ * lock lifetimes, cache expiry and the hint scheduler's timers. Latency
+ * statistics keep using the real clock.
+ *
+ * By default this is CLOCK_MONOTONIC. Host tools can switch to a
+ * simulated clock before power_init(); it then only moves when stepped,
+ * and stepping it runs every scheduler timer that falls due on the way,
+ * in deadline order and with the clock set to each deadline. A
+ * simulated clock must be driven from a single thread.
+ */
+long long power_clock_now_ns(void);
+
+/* Sleeps until 'deadline_ns'; on a simulated clock, steps it there. */
+void power_clock_sleep_until(long long deadline_ns);
+
+/* Switches to a simulated clock reading 'start_ns', which must be > 0. */
+void power_clock_simulate(long long start_ns);
+bool power_clock_simulated(void);
+
+/* Steps a simulated clock forward to 'target_ns', firing timers on the way. */
+void power_clock_advance_to(long long target_ns);
+void power_clock_advance(long long delta_ns);
+
+#endif
@@ -46,12 +46,19 @@
 #include <hardware/power.h>
 
 #include "utils.h"
+#include "boost-profile.h"
+#include "governor-cache.h"
 #include "metadata-defs.h"
 #include "hint-data.h"
+#include "hint-recorder.h"
+#include "hint-stats.h"
 #include "performance.h"
 #include "power-common.h"
 #include "power-feature.h"
 #include "power-helper.h"
+#include "power-trace.h"
+#include "stats-cache.h"
+#include "stats-parser.h"
 
 #define USINSEC 1000000L
 #define NSINUS 1000L
@@ -81,8 +88,6 @@
 #endif
 #endif
 
-#define LINE_SIZE 128
-
 #ifdef LEGACY_STATS
 /* Use these stats on pre-nougat qualcomm kernels */
 static const char *rpm_param_names[] = {
@@ -155,14 +160,23 @@ static int display_hint_sent;
 void power_init(void)
 {
     ALOGI("QCOM power HAL initing.");
+
+    power_trace_init();
+    hint_recorder_init();
+    recover_hint_locks();
+    governor_cache_init();
+    stats_cache_init();
+    boost_profile_load(BOOST_PROFILE_PATH, get_soc_id());
 }
 
 static void process_video_decode_hint(void *metadata)
 {
-    char governor[80];
+    enum governor_type governor = governor_cache_get(CPU0);
     struct video_decode_metadata_t video_decode_metadata;
+    int *profile;
+    int num_resources;
 
-    if (get_scaling_governor(governor, sizeof(governor)) == -1) {
+    if (governor == GOVERNOR_UNKNOWN) {
         ALOGE("Can't obtain scaling governor.");
 
         return;
@@ -187,22 +201,28 @@ static void process_video_decode_hint(void *metadata)
         return;
     }
 
+    profile = boost_profile_get(BOOST_PROFILE_VIDEO_DECODE, governor, &num_resources);
+
     if (video_decode_metadata.state == 1) {
-        if (is_ondemand_governor(governor)) {
+        if (profile) {
+            perform_hint_action(video_decode_metadata.hint_id, profile, num_resources);
+        } else if (governor == GOVERNOR_ONDEMAND) {
             int resource_values[] = {THREAD_MIGRATION_SYNC_OFF};
 
             perform_hint_action(video_decode_metadata.hint_id,
                     resource_values, ARRAY_SIZE(resource_values));
-        } else if (is_interactive_governor(governor)) {
+        } else if (governor == GOVERNOR_INTERACTIVE) {
             int resource_values[] = {TR_MS_30, HISPEED_LOAD_90, HS_FREQ_1026, THREAD_MIGRATION_SYNC_OFF};
 
             perform_hint_action(video_decode_metadata.hint_id,
                     resource_values, ARRAY_SIZE(resource_values));
         }
     } else if (video_decode_metadata.state == 0) {
-        if (is_ondemand_governor(governor)) {
+        if (profile) {
+            undo_hint_action(video_decode_metadata.hint_id);
+        } else if (governor == GOVERNOR_ONDEMAND) {
             undo_hint_action(video_decode_metadata.hint_id);
-        } else if (is_interactive_governor(governor)) {
+        } else if (governor == GOVERNOR_INTERACTIVE) {
             undo_hint_action(video_decode_metadata.hint_id);
         }
     }
@@ -210,10 +230,12 @@ static void process_video_decode_hint(void *metadata)
 
 static void process_video_encode_hint(void *metadata)
 {
-    char governor[80];
+    enum governor_type governor = governor_cache_get(CPU0);
     struct video_encode_metadata_t video_encode_metadata;
+    int *profile;
+    int num_resources;
 
-    if (get_scaling_governor(governor, sizeof(governor)) == -1) {
+    if (governor == GOVERNOR_UNKNOWN) {
         ALOGE("Can't obtain scaling governor.");
 
         return;
@@ -234,13 +256,17 @@ static void process_video_encode_hint(void *metadata)
         return;
     }
 
+    profile = boost_profile_get(BOOST_PROFILE_VIDEO_ENCODE, governor, &num_resources);
+
     if (video_encode_metadata.state == 1) {
-        if (is_ondemand_governor(governor)) {
+        if (profile) {
+            perform_hint_action(video_encode_metadata.hint_id, profile, num_resources);
+        } else if (governor == GOVERNOR_ONDEMAND) {
             int resource_values[] = {IO_BUSY_OFF, SAMPLING_DOWN_FACTOR_1, THREAD_MIGRATION_SYNC_OFF};
 
             perform_hint_action(video_encode_metadata.hint_id,
                     resource_values, ARRAY_SIZE(resource_values));
-        } else if (is_interactive_governor(governor)) {
+        } else if (governor == GOVERNOR_INTERACTIVE) {
             int resource_values[] = {TR_MS_30, HISPEED_LOAD_90, HS_FREQ_1026, THREAD_MIGRATION_SYNC_OFF,
                 INTERACTIVE_IO_BUSY_OFF};
 
@@ -248,9 +274,11 @@ static void process_video_encode_hint(void *metadata)
                     resource_values, ARRAY_SIZE(resource_values));
         }
     } else if (video_encode_metadata.state == 0) {
-        if (is_ondemand_governor(governor)) {
+        if (profile) {
+            undo_hint_action(video_encode_metadata.hint_id);
+        } else if (governor == GOVERNOR_ONDEMAND) {
             undo_hint_action(video_encode_metadata.hint_id);
-        } else if (is_interactive_governor(governor)) {
+        } else if (governor == GOVERNOR_INTERACTIVE) {
             undo_hint_action(video_encode_metadata.hint_id);
         }
     }
@@ -264,9 +292,12 @@ int __attribute__ ((weak)) power_hint_override(power_hint_t UNUSED(hint),
 
 void power_hint(power_hint_t hint, void *data)
 {
+    HINT_RECORDER_POWER_HINT(hint, data);
+
     /* Check if this hint has been overridden. */
     if (power_hint_override(hint, data) == HINT_HANDLED) {
         /* The power_hint has been handled. We can skip the rest. */
+        hint_stats_note(HINT_OUTCOME_HANDLED);
         return;
     }
 
@@ -279,9 +310,11 @@ void power_hint(power_hint_t hint, void *data)
         break;
         case POWER_HINT_VIDEO_ENCODE:
             process_video_encode_hint(data);
+            hint_stats_note(HINT_OUTCOME_HANDLED);
         break;
         case POWER_HINT_VIDEO_DECODE:
             process_video_decode_hint(data);
+            hint_stats_note(HINT_OUTCOME_HANDLED);
         break;
         default:
         break;
@@ -304,7 +337,11 @@ extern void power_set_interactive_ext(int on);
 
 void power_set_interactive(int on)
 {
-    char governor[80];
+    enum governor_type governor;
+    int *profile;
+    int num_resources;
+
+    HINT_RECORDER_CALL(HINT_RECORD_SET_INTERACTIVE, 0, on);
 
     if (!on) {
         /* Send Display OFF hint to perf HAL */
@@ -318,8 +355,10 @@ void power_set_interactive(int on)
      * Ignore consecutive display-off hints
      * Consecutive display-on hints are already handled
      */
-    if (display_hint_sent && !on)
+    if (display_hint_sent && !on) {
+        hint_stats_note(HINT_OUTCOME_SUPPRESSED);
         return;
+    }
 
     display_hint_sent = !on;
 
@@ -328,25 +367,33 @@ void power_set_interactive(int on)
 #endif
 
     if (set_interactive_override(on) == HINT_HANDLED) {
+        hint_stats_note(HINT_OUTCOME_HANDLED);
         return;
     }
 
     ALOGI("Got set_interactive hint");
 
-    if (get_scaling_governor(governor, sizeof(governor)) == -1) {
+    governor = governor_cache_get(CPU0);
+    if (governor == GOVERNOR_UNKNOWN) {
         ALOGE("Can't obtain scaling governor.");
+        hint_stats_note(HINT_OUTCOME_ERROR);
 
         return;
     }
 
+    hint_stats_note(HINT_OUTCOME_HANDLED);
+    profile = boost_profile_get(BOOST_PROFILE_DISPLAY_OFF, governor, &num_resources);
+
     if (!on) {
         /* Display off. */
-        if (is_ondemand_governor(governor)) {
+        if (profile) {
+            perform_hint_action(DISPLAY_STATE_HINT_ID, profile, num_resources);
+        } else if (governor == GOVERNOR_ONDEMAND) {
             int resource_values[] = { MS_500, THREAD_MIGRATION_SYNC_OFF };
 
             perform_hint_action(DISPLAY_STATE_HINT_ID,
                     resource_values, ARRAY_SIZE(resource_values));
-        } else if (is_interactive_governor(governor)) {
+        } else if (governor == GOVERNOR_INTERACTIVE) {
             int resource_values[] = {TR_MS_50, THREAD_MIGRATION_SYNC_OFF};
 
             perform_hint_action(DISPLAY_STATE_HINT_ID,
@@ -354,9 +401,11 @@ void power_set_interactive(int on)
         }
     } else {
         /* Display on. */
-        if (is_ondemand_governor(governor)) {
+        if (profile) {
             undo_hint_action(DISPLAY_STATE_HINT_ID);
-        } else if (is_interactive_governor(governor)) {
+        } else if (governor == GOVERNOR_ONDEMAND) {
+            undo_hint_action(DISPLAY_STATE_HINT_ID);
+        } else if (governor == GOVERNOR_INTERACTIVE) {
             undo_hint_action(DISPLAY_STATE_HINT_ID);
         }
     }
@@ -368,10 +417,13 @@ void __attribute__((weak)) set_device_specific_feature(feature_t UNUSED(feature)
 
 void set_feature(feature_t feature, int state)
 {
+    HINT_RECORDER_CALL(HINT_RECORD_SET_FEATURE, feature, state);
+
     switch (feature) {
 #ifdef TAP_TO_WAKE_NODE
         case POWER_FEATURE_DOUBLE_TAP_TO_WAKE:
-            sysfs_write(TAP_TO_WAKE_NODE, state ? "1" : "0");
+            hint_stats_note(sysfs_write(TAP_TO_WAKE_NODE, state ? "1" : "0") ?
+                    HINT_OUTCOME_ERROR : HINT_OUTCOME_HANDLED);
             break;
 #endif
         default:
@@ -458,94 +510,70 @@ int extract_wlan_stats(uint64_t *list) {
 #endif
 #else
 
-static int parse_stats(const char **params, size_t params_size,
-                       uint64_t *list, FILE *fp) {
-    ssize_t nread;
-    size_t len = LINE_SIZE;
-    char *line;
-    size_t params_read = 0;
-    size_t i;
+static struct stats_parser platform_stats_parser =
+        STATS_PARSER_INIT(RPM_SYSTEM_STAT, rpm_stat_map);
 
-    line = malloc(len);
-    if (!line) {
-        ALOGE("%s: no memory to hold line", __func__);
-        return -ENOMEM;
-    }
-
-    while ((params_read < params_size) &&
-        (nread = getline(&line, &len, fp) > 0)) {
-        char *key = line + strspn(line, " \t");
-        char *value = strchr(key, ':');
-        if (!value || (value > (line + len)))
-            continue;
-        *value++ = '\0';
-
-        for (i = 0; i < params_size; i++) {
-            if (!strcmp(key, params[i])) {
-                list[i] = strtoull(value, NULL, 0);
-                params_read++;
-                break;
-            }
-        }
-    }
-    free(line);
-
-    return 0;
-}
-
-static int extract_stats(uint64_t *list, char *file,
-                         struct stat_pair *map, size_t map_size) {
-    FILE *fp;
-    ssize_t read;
-    size_t len = LINE_SIZE;
-    char *line;
-    size_t i, stats_read = 0;
-    int ret = 0;
-
-    fp = fopen(file, "re");
-    if (fp == NULL) {
-        ALOGE("%s: failed to open: %s Error = %s", __func__, file, strerror(errno));
-        return -errno;
-    }
-
-    line = malloc(len);
-    if (!line) {
-        ALOGE("%s: no memory to hold line", __func__);
-        fclose(fp);
-        return -ENOMEM;
-    }
+#ifndef NO_WLAN_STATS
+static struct stats_parser wlan_stats_parser =
+        STATS_PARSER_INIT(WLAN_POWER_STAT, wlan_stat_map);
+#endif
 
-    while ((stats_read < map_size) && (read = getline(&line, &len, fp) != -1)) {
-        size_t begin = strspn(line, " \t");
+static int extract_stats(uint64_t *list, struct stats_parser *parser,
+                         size_t list_size) {
+    int errors[MAX_PLATFORM_STATS * MAX_RPM_PARAMS] = {0};
+    size_t i;
+    int ret;
 
-        for (i = 0; i < map_size; i++) {
-            if (!strncmp(line + begin, map[i].label, strlen(map[i].label))) {
-                stats_read++;
-                break;
-            }
-        }
+    if (list_size > ARRAY_SIZE(errors))
+        return -EINVAL;
 
-        if (i == map_size)
-            continue;
+    ret = stats_parser_parse(parser, list, errors);
+    if (ret)
+        return ret;
 
-        ret = parse_stats(map[i].parameters, map[i].num_parameters,
-                          &list[map[i].stat * MAX_RPM_PARAMS], fp);
-        if (ret < 0)
-            break;
+    /* Missing values are normal, e.g. voters this SoC doesn't have. */
+    for (i = 0; i < list_size; i++) {
+        if (errors[i] && errors[i] != -ENOENT)
+            ALOGE("%s: bad value for stat %zu in %s: %s", __func__, i,
+                    parser->path, strerror(-errors[i]));
     }
-    free(line);
-    fclose(fp);
 
-    return ret;
+    return 0;
 }
 
 int extract_platform_stats(uint64_t *list) {
-    return extract_stats(list, RPM_SYSTEM_STAT, rpm_stat_map, ARRAY_SIZE(rpm_stat_map));
+    return extract_stats(list, &platform_stats_parser,
+                         MAX_PLATFORM_STATS * MAX_RPM_PARAMS);
 }
 
 #ifndef NO_WLAN_STATS
 int extract_wlan_stats(uint64_t *list) {
-    return extract_stats(list, WLAN_POWER_STAT, wlan_stat_map, ARRAY_SIZE(wlan_stat_map));
+    return extract_stats(list, &wlan_stats_parser, WLAN_POWER_PARAMS_COUNT);
 }
 #endif
 #endif
+
+static uint64_t platform_stats_snapshot[MAX_PLATFORM_STATS * MAX_RPM_PARAMS];
+static struct stats_cache platform_stats_cache =
+        STATS_CACHE_INIT(extract_platform_stats, platform_stats_snapshot);
+
+/*
+ * As extract_platform_stats(), but served from a snapshot taken at most
+ * vendor.power.stats_cache_ms ago unless 'force' is set. 'list' must
+ * hold MAX_PLATFORM_STATS * MAX_RPM_PARAMS values.
+ */
+int extract_platform_stats_cached(uint64_t *list, bool force)
+{
+    return stats_cache_get(&platform_stats_cache, list, force);
+}
+
+#ifndef NO_WLAN_STATS
+static uint64_t wlan_stats_snapshot[WLAN_POWER_PARAMS_COUNT];
+static struct stats_cache wlan_stats_cache =
+        STATS_CACHE_INIT(extract_wlan_stats, wlan_stats_snapshot);
+
+int extract_wlan_stats_cached(uint64_t *list, bool force)
+{
+    return stats_cache_get(&wlan_stats_cache, list, force);
+}
+#endif
@@ -35,6 +35,8 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+
 #include "hardware/power.h"
 
 #ifdef LEGACY_STATS
@@ -132,8 +134,10 @@ void power_hint(power_hint_t hint, void *data);
 void power_set_interactive(int on);
 void set_feature(feature_t feature, int state);
 int extract_platform_stats(uint64_t *list);
+int extract_platform_stats_cached(uint64_t *list, bool force);
 #ifndef NO_WLAN_STATS
 int extract_wlan_stats(uint64_t *list);
+int extract_wlan_stats_cached(uint64_t *list, bool force);
 #endif
 int __attribute__ ((weak)) get_number_of_profiles();
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NO_POWER_TRACE
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+
+#include "power-trace.h"
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+/* trace_marker truncates longer writes anyway. */
+#define TRACE_EVENT_SIZE 512
+
+int power_trace_fd = -1;
+static int trace_pid;
+
+/*
+ * Called once from power_init(), before any hint can run. The fd is
+ * never closed or swapped afterwards, so writers need no lock: each
+ * event is one write(), which the kernel applies atomically.
+ */
+void power_trace_init(void)
+{
+    int fd;
+
+    if (power_trace_fd >= 0 || !property_get_bool(POWER_TRACE_PROP, false))
+        return;
+
+    fd = open(POWER_TRACE_MARKER, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        fd = open(POWER_TRACE_MARKER_LEGACY, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("Unable to open trace_marker: %s", strerror(errno));
+        return;
+    }
+
+    trace_pid = getpid();
+    power_trace_fd = fd;
+    ALOGI("Boost tracing enabled");
+}
+
+static void trace_write(const char *buf, int len)
+{
+    if (len <= 0)
+        return;
+    if (len >= TRACE_EVENT_SIZE)
+        len = TRACE_EVENT_SIZE - 1;
+
+    /* Losing an event is better than blocking a hint on it. */
+    if (write(power_trace_fd, buf, len) < 0)
+        ALOGV("trace_marker write failed: %s", strerror(errno));
+}
+
+void power_trace_begin(const int *resources, int num_resources,
+        const char *fmt, ...)
+{
+    char buf[TRACE_EVENT_SIZE];
+    va_list args;
+    int len, i;
+
+    len = snprintf(buf, sizeof(buf), "B|%d|", trace_pid);
+    va_start(args, fmt);
+    len += vsnprintf(buf + len, sizeof(buf) - len, fmt, args);
+    va_end(args);
+
+    for (i = 0; i < num_resources && len < TRACE_EVENT_SIZE; i++) {
+        len += snprintf(buf + len, sizeof(buf) - len, "%s0x%x",
+                i ? "," : " res=", resources[i]);
+    }
+
+    trace_write(buf, len);
+}
+
+void power_trace_end(void)
+{
+    char buf[32];
+
+    trace_write(buf, snprintf(buf, sizeof(buf), "E|%d", trace_pid));
+}
+
+void power_trace_counter(int64_t value, const char *fmt, ...)
+{
+    char buf[TRACE_EVENT_SIZE];
+    va_list args;
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "C|%d|", trace_pid);
+    va_start(args, fmt);
+    len += vsnprintf(buf + len, sizeof(buf) - len, fmt, args);
+    va_end(args);
+    if (len < TRACE_EVENT_SIZE)
+        len += snprintf(buf + len, sizeof(buf) - len, "|%" PRId64, value);
+
+    trace_write(buf, len);
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_TRACE_H
+#define _QCOM_POWER_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define POWER_TRACE_PROP "vendor.power.trace"
+#define POWER_TRACE_MARKER "/sys/kernel/tracing/trace_marker"
+#define POWER_TRACE_MARKER_LEGACY "/sys/kernel/debug/tracing/trace_marker"
+
+/*
+ * Boost acquire/release events in atrace format, so that systrace and
+ * perfetto show them next to the sched and cpufreq tracepoints.
+ *
+ * Tracing is compiled out with NO_POWER_TRACE and otherwise stays off
+ * unless POWER_TRACE_PROP is set when the HAL starts. While off, every
+ * POWER_TRACE_* macro is a single predictable branch and no argument
+ * is formatted.
+ */
+#ifdef NO_POWER_TRACE
+
+#define power_trace_init() do { } while (0)
+#define power_trace_enabled() false
+#define POWER_TRACE_BEGIN(...) do { } while (0)
+#define POWER_TRACE_END() do { } while (0)
+#define POWER_TRACE_COUNTER(...) do { } while (0)
+
+#else
+
+/* Cached trace_marker fd; -1 while tracing is off. */
+extern int power_trace_fd;
+
+void power_trace_init(void);
+
+/* Opens a slice; 'resources' (may be NULL) are appended as opcodes. */
+void power_trace_begin(const int *resources, int num_resources,
+        const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void power_trace_end(void);
+void power_trace_counter(int64_t value, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+static inline bool power_trace_enabled(void)
+{
+    return __builtin_expect(power_trace_fd >= 0, 0);
+}
+
+#define POWER_TRACE_BEGIN(...) \
+    do { if (power_trace_enabled()) power_trace_begin(__VA_ARGS__); } while (0)
+#define POWER_TRACE_END() \
+    do { if (power_trace_enabled()) power_trace_end(); } while (0)
+#define POWER_TRACE_COUNTER(...) \
+    do { if (power_trace_enabled()) power_trace_counter(__VA_ARGS__); } while (0)
+
+#endif
+
+#endif
@@ -19,7 +19,13 @@
 
 // #define LOG_NDEBUG 0
 
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+
 #include <android/log.h>
+#include <cutils/properties.h>
 #include <hidl/HidlTransportSupport.h>
 #include <hardware/power.h>
 #ifdef ARCH_ARM_32
@@ -27,6 +33,18 @@
 #endif
 #include "Power.h"
 
+// Number of binder threads serving the HAL. Hint calls still run one at
+// a time under Power::mHintLock; extra threads let the low power stats
+// calls proceed alongside them.
+#define THREADS_PROP "vendor.power.threads"
+#define DEFAULT_THREADS 1
+#define MAX_THREADS 8
+
+// SCHED_FIFO priority (1-99) for the HAL threads; 0 leaves them SCHED_OTHER.
+#define RT_PRIORITY_PROP "vendor.power.rt_priority"
+// Nice value for the HAL threads when they are not SCHED_FIFO.
+#define NICE_PROP "vendor.power.nice"
+
 using android::sp;
 using android::status_t;
 using android::OK;
@@ -39,6 +57,26 @@ using android::hardware::joinRpcThreadpool;
 using android::hardware::power::V1_1::IPower;
 using android::hardware::power::V1_1::implementation::Power;
 
+// Applied to the main thread before any other thread exists, so the
+// binder pool, hint queue and hint scheduler threads inherit it.
+static void configureScheduling() {
+    int priority = property_get_int32(RT_PRIORITY_PROP, 0);
+    int niceness = property_get_int32(NICE_PROP, 0);
+
+    if (priority > 0) {
+        struct sched_param param = {};
+
+        param.sched_priority = priority < 99 ? priority : 99;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+            ALOGE("Failed to set SCHED_FIFO priority %d: %s", param.sched_priority,
+                    strerror(errno));
+        return;
+    }
+
+    if (niceness != 0 && setpriority(PRIO_PROCESS, 0, niceness) != 0)
+        ALOGE("Failed to set nice %d: %s", niceness, strerror(errno));
+}
+
 int main() {
 #ifdef ARCH_ARM_32
     android::hardware::ProcessState::initWithMmapSize((size_t)16384);
@@ -46,9 +84,12 @@ int main() {
 
     status_t status;
     android::sp<IPower> service = nullptr;
+    int threads;
 
     ALOGI("Power HAL Service 1.1 for QCOM is starting.");
 
+    configureScheduling();
+
     service = new Power();
     if (service == nullptr) {
         ALOGE("Can not create an instance of Power HAL Iface, exiting.");
@@ -56,7 +97,12 @@ int main() {
         goto shutdown;
     }
 
-    configureRpcThreadpool(1, true /*callerWillJoin*/);
+    threads = property_get_int32(THREADS_PROP, DEFAULT_THREADS);
+    if (threads < 1 || threads > MAX_THREADS) {
+        ALOGE("Ignoring %s=%d", THREADS_PROP, threads);
+        threads = DEFAULT_THREADS;
+    }
+    configureRpcThreadpool(threads, true /*callerWillJoin*/);
 
     status = service->registerAsService();
     if (status != OK) {
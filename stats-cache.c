@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <string.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+#include <cutils/properties.h>
+
+#include "power-clock.h"
+#include "stats-cache.h"
+
+static int stats_cache_ttl_ms = STATS_CACHE_DEFAULT_TTL_MS;
+
+static long long now_ms(void)
+{
+    return power_clock_now_ns() / 1000000LL;
+}
+
+void stats_cache_init(void)
+{
+    stats_cache_ttl_ms = property_get_int32(STATS_CACHE_TTL_PROP,
+            STATS_CACHE_DEFAULT_TTL_MS);
+    if (stats_cache_ttl_ms < 0)
+        stats_cache_ttl_ms = 0;
+
+    ALOGI("Stats snapshots are reused for %d ms", stats_cache_ttl_ms);
+}
+
+/*
+ * Copies the cached stats into 'list', re-reading them first if the
+ * snapshot is older than the freshness window or 'force' is set. The
+ * lock is held across the read, so concurrent callers wait for it and
+ * then share its result. Failed reads are not cached.
+ */
+int stats_cache_get(struct stats_cache *cache, uint64_t *list, bool force)
+{
+    long long now;
+    int ret = 0;
+
+    pthread_mutex_lock(&cache->lock);
+
+    now = now_ms();
+    if (force || !cache->refreshed_ms ||
+            now - cache->refreshed_ms >= stats_cache_ttl_ms) {
+        memset(cache->values, 0, cache->count * sizeof(uint64_t));
+        ret = cache->extract(cache->values);
+        cache->refreshed_ms = ret ? 0 : now;
+    }
+
+    if (!ret)
+        memcpy(list, cache->values, cache->count * sizeof(uint64_t));
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return ret;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_STATS_CACHE_H
+#define _QCOM_POWER_STATS_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define STATS_CACHE_TTL_PROP "vendor.power.stats_cache_ms"
+#define STATS_CACHE_DEFAULT_TTL_MS 100
+
+/*
+ * Holds the last successful result of 'extract' so that callers polling
+ * within the freshness window share one read of the stats file.
+ */
+struct stats_cache {
+    int (*extract)(uint64_t *list);
+    uint64_t *values;
+    size_t count;
+    pthread_mutex_t lock;
+    long long refreshed_ms;     /* power clock; 0 = never */
+};
+
+#define STATS_CACHE_INIT(fn, buf) \
+    { .extract = (fn), .values = (buf), .count = sizeof(buf) / sizeof((buf)[0]), \
+      .lock = PTHREAD_MUTEX_INITIALIZER }
+
+void stats_cache_init(void);
+int stats_cache_get(struct stats_cache *cache, uint64_t *list, bool force);
+
+#endif
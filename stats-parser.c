@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Single pass parser for the nougat+ rpm system_stats and WLAN
+ * power_stats files, which look like:
+ *
+ * RPM Mode:vlow
+ *         count:1234
+ *         actual last sleep(msec):5678
+ * APSS
+ *         Accumulated XO duration:100000
+ *         XO Count:10
+ *
+ * Section labels are matched against a trie built from the stat map,
+ * and a section's keys are only looked for until the next label.
+ * While the recorded section offsets still hold, only those sections
+ * are parsed; a full scan runs when they move and every
+ * STATS_FULL_SCAN_INTERVAL parses.
+ */
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "QCOM PowerHAL"
+#include <log/log.h>
+
+#include "power-common.h"
+#include "stats-parser.h"
+
+#define STATS_BUF_INITIAL_SIZE 4096
+#define STATS_BUF_MAX_SIZE (64 * 1024)
+/* Rescan now and then so sections that weren't there before show up. */
+#define STATS_FULL_SCAN_INTERVAL 64
+
+static int trie_add(struct stats_parser *parser, const char *label, int section)
+{
+    int node = 0;
+
+    for (; *label; label++) {
+        int child = parser->trie[node].child;
+
+        while (child >= 0 && parser->trie[child].c != *label)
+            child = parser->trie[child].sibling;
+
+        if (child < 0) {
+            if (parser->num_nodes == STATS_PARSER_MAX_NODES)
+                return -ENOSPC;
+            child = parser->num_nodes++;
+            parser->trie[child].c = *label;
+            parser->trie[child].section = 0;
+            parser->trie[child].child = -1;
+            parser->trie[child].sibling = parser->trie[node].child;
+            parser->trie[node].child = child;
+        }
+        node = child;
+    }
+
+    if (!parser->trie[node].section)
+        parser->trie[node].section = section + 1;
+
+    return 0;
+}
+
+static int stats_parser_init(struct stats_parser *parser)
+{
+    size_t i;
+    int ret;
+
+    if (parser->map_size > STATS_PARSER_MAX_SECTIONS)
+        return -EINVAL;
+
+    parser->trie[0].child = -1;
+    parser->trie[0].sibling = -1;
+    parser->trie[0].section = 0;
+    parser->num_nodes = 1;
+
+    for (i = 0; i < parser->map_size; i++) {
+        ret = trie_add(parser, parser->map[i].label, i);
+        if (ret)
+            return ret;
+        parser->offsets[i] = -1;
+    }
+
+    parser->initialized = true;
+    return 0;
+}
+
+/*
+ * Returns the section whose label the line at 'p' starts with, picking
+ * the longest label if several match, or -1.
+ */
+static int match_label(const struct stats_parser *parser, const char *p)
+{
+    int node = 0;
+    int section = -1;
+
+    p += strspn(p, " \t");
+    for (; *p && *p != '\n'; p++) {
+        int child = parser->trie[node].child;
+
+        while (child >= 0 && parser->trie[child].c != *p)
+            child = parser->trie[child].sibling;
+        if (child < 0)
+            break;
+
+        node = child;
+        if (parser->trie[node].section)
+            section = parser->trie[node].section - 1;
+    }
+
+    return section;
+}
+
+static const char *next_line(const char *p)
+{
+    const char *nl = strchr(p, '\n');
+
+    return nl ? nl + 1 : p + strlen(p);
+}
+
+/*
+ * Parses the keys of 'section', whose label line starts at 'p', until
+ * all are found or another label starts. Returns where it stopped.
+ */
+static const char *parse_section(const struct stats_parser *parser,
+        int section, const char *p, uint64_t *list, int *errors)
+{
+    const struct stat_pair *pair = &parser->map[section];
+    uint64_t *values = &list[pair->stat * MAX_RPM_PARAMS];
+    int *value_errors = errors ? &errors[pair->stat * MAX_RPM_PARAMS] : NULL;
+    size_t remaining = pair->num_parameters;
+    size_t i;
+
+    for (p = next_line(p); *p && remaining; p = next_line(p)) {
+        const char *key = p + strspn(p, " \t");
+        const char *colon, *eol;
+        size_t key_len;
+
+        if (match_label(parser, p) >= 0)
+            break;
+
+        eol = strchr(key, '\n');
+        colon = memchr(key, ':', eol ? (size_t)(eol - key) : strlen(key));
+        if (!colon)
+            continue;
+        key_len = colon - key;
+
+        for (i = 0; i < pair->num_parameters; i++) {
+            const char *param = pair->parameters[i];
+            char *end;
+
+            if (strncmp(key, param, key_len) || param[key_len] != '\0')
+                continue;
+
+            errno = 0;
+            values[i] = strtoull(colon + 1, &end, 0);
+            if (value_errors) {
+                if (end == colon + 1)
+                    value_errors[i] = -EINVAL;
+                else
+                    value_errors[i] = errno ? -errno : 0;
+            }
+            remaining--;
+            break;
+        }
+    }
+
+    return p;
+}
+
+static int read_stats_file(struct stats_parser *parser)
+{
+    size_t len = 0;
+    int fd;
+
+    fd = open(parser->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        int ret = -errno;
+        ALOGE("%s: failed to open: %s Error = %s", __func__, parser->path,
+                strerror(errno));
+        return ret;
+    }
+
+    for (;;) {
+        ssize_t n;
+
+        if (len + 1 >= parser->buf_size) {
+            size_t size = parser->buf_size ? parser->buf_size * 2 :
+                    STATS_BUF_INITIAL_SIZE;
+            char *buf;
+
+            if (size > STATS_BUF_MAX_SIZE) {
+                ALOGE("%s: %s is larger than %d bytes", __func__, parser->path,
+                        STATS_BUF_MAX_SIZE);
+                break;
+            }
+            buf = realloc(parser->buf, size);
+            if (!buf) {
+                close(fd);
+                return -ENOMEM;
+            }
+            parser->buf = buf;
+            parser->buf_size = size;
+        }
+
+        n = TEMP_FAILURE_RETRY(read(fd, parser->buf + len,
+                parser->buf_size - len - 1));
+        if (n < 0) {
+            int ret = -errno;
+            close(fd);
+            return ret;
+        }
+        if (n == 0)
+            break;
+        len += n;
+    }
+
+    close(fd);
+    parser->buf[len] = '\0';
+
+    return len;
+}
+
+/*
+ * Tries the section offsets recorded by the last full scan. Fails if
+ * any recorded label is no longer where it was.
+ */
+static bool parse_known_offsets(struct stats_parser *parser, size_t len,
+        uint64_t *list, int *errors)
+{
+    size_t i;
+    bool any = false;
+
+    for (i = 0; i < parser->map_size; i++) {
+        ssize_t off = parser->offsets[i];
+
+        if (off < 0)
+            continue;
+        if ((size_t)off >= len || (off > 0 && parser->buf[off - 1] != '\n') ||
+                match_label(parser, parser->buf + off) != (int)i)
+            return false;
+        any = true;
+    }
+
+    if (!any)
+        return false;
+
+    for (i = 0; i < parser->map_size; i++) {
+        if (parser->offsets[i] >= 0)
+            parse_section(parser, i, parser->buf + parser->offsets[i], list, errors);
+    }
+
+    return true;
+}
+
+static void parse_full(struct stats_parser *parser, uint64_t *list, int *errors)
+{
+    const char *p = parser->buf;
+    size_t i;
+
+    for (i = 0; i < parser->map_size; i++)
+        parser->offsets[i] = -1;
+
+    while (*p) {
+        int section = match_label(parser, p);
+
+        if (section < 0 || parser->offsets[section] >= 0) {
+            p = next_line(p);
+            continue;
+        }
+
+        parser->offsets[section] = p - parser->buf;
+        p = parse_section(parser, section, p, list, errors);
+    }
+}
+
+/*
+ * Fills 'list' from the stats file. If 'errors' is given, it is laid
+ * out like 'list' and receives 0 for every value read, -ENOENT for
+ * values missing from the file and -EINVAL/-ERANGE for unparsable ones.
+ * Returns 0, or a negative errno if the file could not be read.
+ */
+int stats_parser_parse(struct stats_parser *parser, uint64_t *list, int *errors)
+{
+    size_t i, j;
+    int ret;
+
+    pthread_mutex_lock(&parser->lock);
+
+    if (!parser->initialized) {
+        ret = stats_parser_init(parser);
+        if (ret) {
+            ALOGE("%s: bad stat map for %s", __func__, parser->path);
+            goto out;
+        }
+    }
+
+    if (errors) {
+        for (i = 0; i < parser->map_size; i++) {
+            const struct stat_pair *pair = &parser->map[i];
+            for (j = 0; j < pair->num_parameters; j++)
+                errors[pair->stat * MAX_RPM_PARAMS + j] = -ENOENT;
+        }
+    }
+
+    ret = read_stats_file(parser);
+    if (ret < 0)
+        goto out;
+
+    if (++parser->fast_parses >= STATS_FULL_SCAN_INTERVAL ||
+            !parse_known_offsets(parser, ret, list, errors)) {
+        parse_full(parser, list, errors);
+        parser->fast_parses = 0;
+    }
+    ret = 0;
+
+out:
+    pthread_mutex_unlock(&parser->lock);
+    return ret;
+}
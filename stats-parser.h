@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _QCOM_POWER_STATS_PARSER_H
+#define _QCOM_POWER_STATS_PARSER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "power-helper.h"
+
+#define STATS_PARSER_MAX_SECTIONS 16
+#define STATS_PARSER_MAX_NODES 256
+
+struct stats_trie_node {
+    char c;
+    unsigned char section;  /* map index + 1 if a label ends here */
+    short child;            /* first child, -1 if none */
+    short sibling;          /* next sibling, -1 if none */
+};
+
+/*
+ * Parses one "label / key:value" stats file as described by 'map'.
+ * The file is read into a buffer kept across calls, and the offset of
+ * each section is remembered so the next parse can go straight to it.
+ */
+struct stats_parser {
+    const char *path;
+    const struct stat_pair *map;
+    size_t map_size;
+
+    pthread_mutex_t lock;
+    bool initialized;
+    struct stats_trie_node trie[STATS_PARSER_MAX_NODES];
+    int num_nodes;
+    ssize_t offsets[STATS_PARSER_MAX_SECTIONS];
+    unsigned int fast_parses;
+    char *buf;
+    size_t buf_size;
+};
+
+#define STATS_PARSER_INIT(file, stat_map) \
+    { .path = (file), .map = (stat_map), .map_size = ARRAY_SIZE(stat_map), \
+      .lock = PTHREAD_MUTEX_INITIALIZER }
+
+int stats_parser_parse(struct stats_parser *parser, uint64_t *list, int *errors);
+
+#endif
@@ -31,15 +31,28 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "utils.h"
-#include "list.h"
+#include "governor-cache.h"
+#include "hint-audit.h"
+#include "hint-client.h"
 #include "hint-data.h"
+#include "hint-scheduler.h"
+#include "hint-stats.h"
+#include "lock-journal.h"
+#include "perf-arbiter.h"
+#include "perf-batch.h"
+#include "perf-lock.h"
+#include "perf-native.h"
 #include "power-common.h"
+#include "power-clock.h"
 #include "power-helper.h"
+#include "power-trace.h"
 
 #define LOG_TAG "QCOM PowerHAL"
 #include <log/log.h>
@@ -47,6 +60,9 @@
 #define USINSEC 1000000L
 #define NSINUS 1000L
 
+/* Must be a power of two */
+#define SYSFS_FD_CACHE_SIZE 32
+
 #define SOC_ID_0 "/sys/devices/soc0/soc_id"
 #define SOC_ID_1 "/sys/devices/system/soc/soc0/id"
 
@@ -63,7 +79,36 @@ static int (*perf_lock_acq)(unsigned long handle, int duration,
     int list[], int numArgs);
 static int (*perf_lock_rel)(unsigned long handle);
 static int (*perf_hint)(int, char *, int, int);
-static struct list_node active_hint_list_head;
+static int timed_perf_lock_acq(unsigned long handle, int duration,
+    int list[], int num_args);
+static int timed_perf_lock_rel(unsigned long handle);
+static const struct perf_batch_ops batch_ops = {
+    .acquire = timed_perf_lock_acq,
+    .release = timed_perf_lock_rel,
+};
+static int backend_acquire(int handle, int duration, int list[], int num_args);
+static int backend_release(int handle);
+static const struct perf_arbiter_ops arbiter_ops = {
+    .acquire = backend_acquire,
+    .release = backend_release,
+};
+static struct hint_table active_hints;
+static pthread_mutex_t active_hints_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Nodes written or read on the hint paths are opened once and then
+ * accessed with pread/pwrite at offset 0. Entries are keyed by path and
+ * open flags, and dropped again when the node goes away (e.g. the
+ * cpufreq directory of a hotplugged CPU).
+ */
+struct sysfs_fd_entry {
+    char *path;
+    int flags;
+    int fd;
+};
+
+static struct sysfs_fd_entry sysfs_fd_cache[SYSFS_FD_CACHE_SIZE];
+static pthread_mutex_t sysfs_fd_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void *get_qcopt_handle()
 {
@@ -120,6 +165,15 @@ static void __attribute__ ((constructor)) initialize(void)
             ALOGE("Unable to get perf_hint function handle.\n");
         }
     }
+
+    if ((!perf_lock_acq || !perf_lock_rel) && !perf_native_init(PERF_NATIVE_ROOT)) {
+        ALOGI("perfd unavailable, applying perf locks through sysfs");
+        perf_lock_acq = perf_native_acquire;
+        perf_lock_rel = perf_native_release;
+    }
+
+    perf_batch_init(&batch_ops);
+    perf_arbiter_init(&arbiter_ops);
 }
 
 static void __attribute__ ((destructor)) cleanup(void)
@@ -130,81 +184,234 @@ static void __attribute__ ((destructor)) cleanup(void)
     }
 }
 
-int sysfs_read(const char *path, char *s, int num_bytes)
+static unsigned int sysfs_fd_hash(const char *path, int flags)
+{
+    unsigned int hash = 5381;
+
+    while (*path)
+        hash = hash * 33 + (unsigned char)*path++;
+
+    return (hash ^ flags) & (SYSFS_FD_CACHE_SIZE - 1);
+}
+
+/*
+ * Returns the slot caching 'path', opening and inserting it if needed,
+ * or NULL if the node can't be opened or the cache is full. In the
+ * latter case 'fd' still holds an uncached descriptor the caller owns.
+ * Must be called with sysfs_fd_lock held.
+ */
+static struct sysfs_fd_entry *sysfs_fd_get(const char *path, int flags,
+        int *fd)
+{
+    unsigned int idx = sysfs_fd_hash(path, flags);
+    struct sysfs_fd_entry *free_slot = NULL;
+    unsigned int i;
+
+    for (i = 0; i < SYSFS_FD_CACHE_SIZE; i++) {
+        struct sysfs_fd_entry *entry =
+            &sysfs_fd_cache[(idx + i) & (SYSFS_FD_CACHE_SIZE - 1)];
+
+        if (!entry->path) {
+            if (!free_slot)
+                free_slot = entry;
+            continue;
+        }
+
+        if (entry->flags == flags && !strcmp(entry->path, path)) {
+            *fd = entry->fd;
+            return entry;
+        }
+    }
+
+    *fd = open(path, flags | O_CLOEXEC);
+    if (*fd < 0 || !free_slot)
+        return NULL;
+
+    free_slot->path = strdup(path);
+    if (!free_slot->path)
+        return NULL;
+    free_slot->flags = flags;
+    free_slot->fd = *fd;
+
+    return free_slot;
+}
+
+/* Must be called with sysfs_fd_lock held. */
+static void sysfs_fd_invalidate(struct sysfs_fd_entry *entry)
+{
+    close(entry->fd);
+    free(entry->path);
+    entry->path = NULL;
+    entry->fd = -1;
+}
+
+/*
+ * Performs a read or write at offset 0 on a cached descriptor. If the
+ * node has disappeared since it was opened, the entry is dropped and the
+ * operation retried once on a freshly opened descriptor.
+ */
+static ssize_t sysfs_fd_io(const char *path, int flags, char *buf,
+        size_t len, int *open_err)
+{
+    struct sysfs_fd_entry *entry;
+    ssize_t ret = -1;
+    int retry;
+    int fd;
+
+    *open_err = 0;
+
+    pthread_mutex_lock(&sysfs_fd_lock);
+    for (retry = 0; retry < 2; retry++) {
+        entry = sysfs_fd_get(path, flags, &fd);
+        if (fd < 0) {
+            *open_err = errno;
+            break;
+        }
+
+        if (flags == O_RDONLY)
+            ret = pread(fd, buf, len, 0);
+        else
+            ret = pwrite(fd, buf, len, 0);
+
+        if (!entry) {
+            int saved_errno = errno;
+
+            close(fd);
+            errno = saved_errno;
+            break;
+        }
+
+        if (ret >= 0 || (errno != ENODEV && errno != ENOENT))
+            break;
+
+        sysfs_fd_invalidate(entry);
+    }
+    pthread_mutex_unlock(&sysfs_fd_lock);
+
+    return ret;
+}
+
+static int do_sysfs_read(const char *path, char *s, int num_bytes)
 {
     char buf[80];
-    int count;
-    int ret = 0;
-    int fd = open(path, O_RDONLY);
+    ssize_t count;
+    int open_err;
 
-    if (fd < 0) {
-        strerror_r(errno, buf, sizeof(buf));
+    count = sysfs_fd_io(path, O_RDONLY, s, num_bytes - 1, &open_err);
+    if (open_err) {
+        strerror_r(open_err, buf, sizeof(buf));
         ALOGE("Error opening %s: %s\n", path, buf);
 
         return -1;
     }
 
-    if ((count = read(fd, s, num_bytes - 1)) < 0) {
+    if (count < 0) {
         strerror_r(errno, buf, sizeof(buf));
-        ALOGE("Error writing to %s: %s\n", path, buf);
+        ALOGE("Error reading from %s: %s\n", path, buf);
 
-        ret = -1;
-    } else {
-        s[count] = '\0';
+        return -1;
     }
 
-    close(fd);
+    s[count] = '\0';
 
-    return ret;
+    return 0;
 }
 
-int sysfs_write(const char *path, char *s)
+static int do_sysfs_write(const char *path, char *s)
 {
     char buf[80];
-    int len;
-    int ret = 0;
-    int fd = open(path, O_WRONLY);
+    ssize_t len;
+    int open_err;
 
-    if (fd < 0) {
-        strerror_r(errno, buf, sizeof(buf));
+    len = sysfs_fd_io(path, O_WRONLY, s, strlen(s), &open_err);
+    if (open_err) {
+        strerror_r(open_err, buf, sizeof(buf));
         ALOGE("Error opening %s: %s\n", path, buf);
-        return -1 ;
+        return -1;
     }
 
-    len = write(fd, s, strlen(s));
     if (len < 0) {
         strerror_r(errno, buf, sizeof(buf));
         ALOGE("Error writing to %s: %s\n", path, buf);
 
-        ret = -1;
+        return -1;
     }
 
-    close(fd);
+    return 0;
+}
+
+int sysfs_read(const char *path, char *s, int num_bytes)
+{
+    uint64_t start = hint_stats_now();
+    int ret = do_sysfs_read(path, s, num_bytes);
 
+    hint_stats_record(HINT_STATS_SYSFS_READ, hint_stats_now() - start,
+            ret ? HINT_OUTCOME_ERROR : HINT_OUTCOME_HANDLED);
     return ret;
 }
 
+int sysfs_write(const char *path, char *s)
+{
+    uint64_t start = hint_stats_now();
+    int ret = do_sysfs_write(path, s);
+
+    hint_stats_record(HINT_STATS_SYSFS_WRITE, hint_stats_now() - start,
+            ret ? HINT_OUTCOME_ERROR : HINT_OUTCOME_HANDLED);
+    return ret;
+}
+
+static void strip_newline(char governor[])
+{
+    int len = strlen(governor);
+
+    len--;
+
+    while (len >= 0 && (governor[len] == '\n' || governor[len] == '\r'))
+        governor[len--] = '\0';
+}
+
+/*
+ * Serves the governor of 'cpu' from the governor cache. Returns -1 if
+ * the cache can't name it, in which case the caller reads sysfs.
+ */
+static int get_cached_governor(char governor[], int size, int cpu)
+{
+    enum governor_type type = governor_cache_get(cpu);
+
+    if (type == GOVERNOR_UNKNOWN || type == GOVERNOR_OTHER)
+        return -1;
+
+    strlcpy(governor, governor_type_name(type), size);
+
+    return 0;
+}
+
 int get_scaling_governor(char governor[], int size)
 {
+    if (get_cached_governor(governor, size, CPU0) == 0)
+        return 0;
+
     if (sysfs_read(SCALING_GOVERNOR_PATH, governor,
                 size) == -1) {
         // Can't obtain the scaling governor. Return.
         return -1;
-    } else {
-        // Strip newline at the end.
-        int len = strlen(governor);
-
-        len--;
-
-        while (len >= 0 && (governor[len] == '\n' || governor[len] == '\r'))
-            governor[len--] = '\0';
     }
 
+    // Strip newline at the end.
+    strip_newline(governor);
+
     return 0;
 }
 
 int get_scaling_governor_check_cores(char governor[], int size,int core_num)
 {
+    if (get_cached_governor(governor, size, core_num) == 0)
+        return 0;
+
+    if (governor_cache_get(core_num) == GOVERNOR_UNKNOWN) {
+        // CPU is offline or has no cpufreq policy.
+        return -1;
+    }
 
     if (sysfs_read(scaling_gov_path[core_num], governor,
                 size) == -1) {
@@ -213,10 +420,7 @@ int get_scaling_governor_check_cores(char governor[], int size,int core_num)
     }
 
     // Strip newline at the end.
-    int len = strlen(governor);
-    len--;
-    while (len >= 0 && (governor[len] == '\n' || governor[len] == '\r'))
-        governor[len--] = '\0';
+    strip_newline(governor);
 
     return 0;
 }
@@ -233,125 +437,535 @@ int is_ondemand_governor(char* governor) {
    return 0;
 }
 
-void interaction(int duration, int num_args, int opt_list[])
+/*
+ * perfd is reached over IPC; timing each call lets the debug dump tell a
+ * slow perfd apart from slow work in the HAL itself.
+ */
+static int timed_perf_lock_acq(unsigned long handle, int duration,
+    int list[], int num_args)
 {
-    static int lock_handle = 0;
+    uint64_t start = hint_stats_now();
+    int ret = perf_lock_acq(handle, duration, list, num_args);
+
+    hint_stats_record(HINT_STATS_PERF_LOCK_ACQ, hint_stats_now() - start,
+            ret == -1 ? HINT_OUTCOME_ERROR : HINT_OUTCOME_HANDLED);
+
+    /* Timed locks lapse on their own; only indefinite ones can leak. */
+    if (ret > 0 && duration == 0)
+        lock_journal_add(LOCK_JOURNAL_PERFD, ret, NULL, 0);
+    else if (ret > 0)
+        lock_journal_remove(LOCK_JOURNAL_PERFD, ret);
+    if (handle && ret != (int)handle)
+        lock_journal_remove(LOCK_JOURNAL_PERFD, handle);
+    return ret;
+}
 
-    if (duration < 0 || num_args < 1 || opt_list[0] == 0)
-        return;
+static int timed_perf_lock_rel(unsigned long handle)
+{
+    uint64_t start;
+    int ret;
 
-    if (qcopt_handle) {
-        if (perf_lock_acq) {
-            lock_handle = perf_lock_acq(lock_handle, duration, opt_list, num_args);
-            if (lock_handle == -1)
-                ALOGV("Failed to acquire lock.");
-        }
+    /*
+     * Forget the lock first: should we die in between, leaking it beats
+     * a later instance releasing a handle perfd may have reissued.
+     */
+    lock_journal_remove(LOCK_JOURNAL_PERFD, handle);
+
+    start = hint_stats_now();
+    ret = perf_lock_rel(handle);
+
+    hint_stats_record(HINT_STATS_PERF_LOCK_REL, hint_stats_now() - start,
+            ret == -1 ? HINT_OUTCOME_ERROR : HINT_OUTCOME_HANDLED);
+    return ret;
+}
+
+static int timed_perf_hint(int hint_id, char *pkg, int duration, int type)
+{
+    uint64_t start = hint_stats_now();
+    int ret = perf_hint(hint_id, pkg, duration, type);
+
+    hint_stats_record(HINT_STATS_PERF_HINT, hint_stats_now() - start,
+            ret == -1 ? HINT_OUTCOME_ERROR : HINT_OUTCOME_HANDLED);
+    if (ret > 0 && duration == 0)
+        lock_journal_add(LOCK_JOURNAL_PERFD, ret, NULL, 0);
+    return ret;
+}
+
+/*
+ * Hint locks are arbitrated in the HAL first; what comes out goes
+ * through the batcher when it is enabled.
+ */
+static int backend_acquire(int handle, int duration, int list[], int num_args)
+{
+    if (perf_batch_enabled())
+        return perf_batch_acquire(handle, duration, list, num_args);
+
+    return timed_perf_lock_acq(handle, duration, list, num_args);
+}
+
+static int backend_release(int handle)
+{
+    if (perf_batch_enabled())
+        return perf_batch_release(handle);
+
+    return timed_perf_lock_rel(handle);
+}
+
+/* Power clock ns the latest timed interaction boost runs until. */
+static long long interaction_trace_end_ns;
+static unsigned int interaction_trace_job = HINT_SCHED_INVALID;
+static pthread_mutex_t interaction_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void end_interaction_trace(void *arg);
+
+/* Called with interaction_trace_lock held. */
+static void arm_interaction_trace(long long now)
+{
+    int delay_ms = (interaction_trace_end_ns - now + 999999) / 1000000;
+
+    interaction_trace_job = hint_schedule_call(delay_ms, end_interaction_trace, NULL);
+    if (interaction_trace_job == HINT_SCHED_INVALID)
+        ALOGV("Unable to schedule the end of the interaction trace");
+}
+
+/*
+ * Drops the boost:interaction counter once no timed boost is left, or
+ * waits for the latest one if the boost was extended meanwhile.
+ */
+static void end_interaction_trace(void *arg)
+{
+    long long now = power_clock_now_ns();
+
+    (void)arg;
+
+    pthread_mutex_lock(&interaction_trace_lock);
+    interaction_trace_job = HINT_SCHED_INVALID;
+    if (now >= interaction_trace_end_ns) {
+        interaction_trace_end_ns = 0;
+        POWER_TRACE_COUNTER(0, "boost:interaction");
+    } else {
+        arm_interaction_trace(now);
+    }
+    pthread_mutex_unlock(&interaction_trace_lock);
+}
+
+/* One job at most is armed; extensions only move the deadline it checks. */
+static void trace_interaction(int duration)
+{
+    long long now = power_clock_now_ns();
+    long long end_ns = now + duration * 1000000LL;
+
+    pthread_mutex_lock(&interaction_trace_lock);
+    POWER_TRACE_COUNTER(duration, "boost:interaction");
+    if (end_ns > interaction_trace_end_ns)
+        interaction_trace_end_ns = end_ns;
+    if (interaction_trace_job == HINT_SCHED_INVALID)
+        arm_interaction_trace(now);
+    pthread_mutex_unlock(&interaction_trace_lock);
+}
+
+//renews the lock behind lock_handle, or acquires a new one
+//if it is 0, and returns the handle to pass next time
+int interaction_with_handle(int lock_handle, int duration, int num_args, int opt_list[])
+{
+    if (duration < 0 || num_args < 1 || opt_list[0] == 0)
+        return lock_handle;
+
+    if (perf_lock_acq) {
+        POWER_TRACE_BEGIN(opt_list, num_args, "interaction handle=%d dur=%d",
+                lock_handle, duration);
+        lock_handle = perf_arbiter_acquire(lock_handle, duration, opt_list, num_args);
+        if (lock_handle == -1)
+            ALOGV("Failed to acquire lock.");
+        else if (power_trace_enabled() && duration > 0)
+            trace_interaction(duration);
+        POWER_TRACE_END();
     }
+    return lock_handle;
+}
+
+void interaction(int duration, int num_args, int opt_list[])
+{
+    static struct perf_lock lock = PERF_LOCK_INIT;
+
+    perf_lock_acquire(&lock, duration, opt_list, num_args);
 }
 
 //this is interaction using perf_hint instead of
 //perf_lock_acq
 int perf_hint_enable(int hint_id , int duration)
+{
+    return perf_hint_enable_with_type(hint_id, duration, -1);
+}
+
+int perf_hint_enable_with_type(int hint_id, int duration, int type)
 {
     int lock_handle = 0;
 
     if (duration < 0)
         return 0;
 
-    if (qcopt_handle) {
-        if (perf_hint) {
-            lock_handle = perf_hint(hint_id, NULL, duration, -1);
-            if (lock_handle == -1)
-                ALOGV("Failed to acquire lock.");
-        }
+    if (perf_hint) {
+        POWER_TRACE_BEGIN(NULL, 0, "perf_hint hint=0x%x dur=%d type=%d",
+                hint_id, duration, type);
+        lock_handle = timed_perf_hint(hint_id, NULL, duration, type);
+        if (lock_handle == -1)
+            ALOGV("Failed to acquire lock.");
+        else
+            POWER_TRACE_COUNTER(duration, "boost:hint 0x%x", hint_id);
+        POWER_TRACE_END();
     }
     return lock_handle;
 }
 
 
 void release_request(int lock_handle) {
-    if (qcopt_handle && perf_lock_rel)
-        perf_lock_rel(lock_handle);
+    if (perf_lock_rel) {
+        POWER_TRACE_BEGIN(NULL, 0, "release_request handle=%d", lock_handle);
+        perf_arbiter_release(lock_handle);
+        POWER_TRACE_END();
+    }
+}
+
+/* Records the resource list of 'hint', or -1 if it is too long to keep. */
+static void hint_set_resources(struct hint_data *hint,
+        const int resource_values[], int num_resources)
+{
+    if (num_resources < 0 || num_resources > HINT_MAX_RESOURCES) {
+        hint->num_resources = -1;
+        return;
+    }
+    memcpy(hint->resources, resource_values, num_resources * sizeof(int));
+    hint->num_resources = num_resources;
+}
+
+/* A list that didn't fit never matches, so its lock is always re-taken. */
+static bool hint_holds(const struct hint_data *hint,
+        const int resource_values[], int num_resources)
+{
+    return hint && hint->num_resources >= 0 &&
+            hint->num_resources == num_resources &&
+            !memcmp(hint->resources, resource_values,
+                    num_resources * sizeof(int));
+}
+
+/* Hints that reflect device state rather than a passing use case. */
+static bool hint_persists(unsigned long hint_id)
+{
+    return hint_id == DISPLAY_STATE_HINT_ID || hint_id == DISPLAY_STATE_HINT_ID_2;
+}
+
+static void drop_hint_lock(const struct hint_data *hint, bool expired);
+
+/* Drops a hint whose client died, unless someone asked for it since. */
+static void release_client_hint(void *owner, unsigned long hint_id,
+        struct hint_client_holder dead)
+{
+    struct hint_data *found, released;
+    int ret = -ENOENT;
+
+    (void)owner;
+
+    pthread_mutex_lock(&active_hints_lock);
+    found = hint_table_find(&active_hints, hint_id);
+    if (found && hint_client_same_holder(found->holder, dead))
+        ret = hint_table_remove(&active_hints, hint_id, &released);
+    pthread_mutex_unlock(&active_hints_lock);
+
+    if (ret == 0)
+        drop_hint_lock(&released, false);
+}
+
+/*
+ * The client 'hint_id' is attributed to. Device state hints are always
+ * held by someone, so they are left out rather than keep the liveness
+ * poll running for as long as the device is up.
+ */
+static struct hint_client_holder hint_holder(int hint_id)
+{
+    struct hint_client_holder nobody = { { 0, 0 }, 0 };
+
+    return hint_persists(hint_id) ? nobody : hint_client_current_holder();
+}
+
+static void track_hint(int hint_id, struct hint_client_holder holder)
+{
+    if (hint_persists(hint_id))
+        hint_client_untrack(&active_hints, hint_id);
+    else
+        hint_client_track(&active_hints, hint_id, holder, "hint",
+                release_client_hint);
 }
 
 int perform_hint_action(int hint_id, int resource_values[], int num_resources)
 {
-    if (qcopt_handle && perf_lock_acq) {
+    if (perf_lock_acq) {
+        struct hint_data new_hint = {
+            .hint_id = hint_id,
+            .holder = hint_holder(hint_id),
+            .since_ns = power_clock_now_ns(),
+        };
+        struct hint_data old_hint, *held;
+        int lock_handle;
+        int ret;
+
+        hint_set_resources(&new_hint, resource_values, num_resources);
+
+        /*
+         * Re-sending an active hint with the same resources keeps its
+         * lock; it only restarts the lock's lifetime.
+         */
+        pthread_mutex_lock(&active_hints_lock);
+        held = hint_table_find(&active_hints, hint_id);
+        ret = hint_holds(held, resource_values, num_resources);
+        if (ret) {
+            held->since_ns = new_hint.since_ns;
+            held->holder = new_hint.holder;
+        }
+        pthread_mutex_unlock(&active_hints_lock);
+        if (ret) {
+            track_hint(hint_id, new_hint.holder);
+            hint_audit_acquired(hint_id, new_hint.since_ns);
+            lock_journal_add(LOCK_JOURNAL_HINT, hint_id, resource_values,
+                    num_resources);
+            return 0;
+        }
+
+        POWER_TRACE_BEGIN(resource_values, num_resources,
+                "perform_hint_action hint=0x%x", hint_id);
+
         /* Acquire an indefinite lock for the requested resources. */
-        int lock_handle = perf_lock_acq(0, 0, resource_values,
-                num_resources);
+        lock_handle = perf_arbiter_acquire(0, 0, resource_values, num_resources);
+        new_hint.perflock_handle = lock_handle;
+        POWER_TRACE_END();
 
         if (lock_handle == -1) {
             ALOGE("Failed to acquire lock.");
             return -EINVAL;
         }
 
-        /* Add this handle to our internal hint-list. */
-        struct hint_data *new_hint =
-            (struct hint_data *)malloc(sizeof(struct hint_data));
+        /* Add this handle to our internal hint table. */
+        pthread_mutex_lock(&active_hints_lock);
+        ret = hint_table_insert(&active_hints, &new_hint, &old_hint);
+        pthread_mutex_unlock(&active_hints_lock);
 
-        if (!new_hint) {
+        if (ret < 0) {
             /* Can't keep track of this lock. Release it. */
             if (perf_lock_rel)
-                perf_lock_rel(lock_handle);
+                perf_arbiter_release(lock_handle);
             ALOGE("Failed to process hint.");
             return -ENOMEM;
         }
-
-        if (!active_hint_list_head.compare) {
-            active_hint_list_head.compare =
-                (int (*)(void *, void *))hint_compare;
-            active_hint_list_head.dump = (void (*)(void *))hint_dump;
+        track_hint(hint_id, new_hint.holder);
+        hint_audit_acquired(hint_id, new_hint.since_ns);
+        lock_journal_add(LOCK_JOURNAL_HINT, hint_id, resource_values, num_resources);
+
+        if (ret > 0 && old_hint.perflock_handle != new_hint.perflock_handle) {
+            /*
+             * The hint was already active; its previous lock is no
+             * longer tracked, so drop it now that the new one is held.
+             */
+            if (perf_lock_rel &&
+                    perf_arbiter_release(old_hint.perflock_handle) == -1)
+                ALOGE("Perflock release failed.");
         }
+        POWER_TRACE_COUNTER(lock_handle, "boost:hint 0x%x", hint_id);
+    }
+    return 0;
+}
 
-        new_hint->hint_id = hint_id;
-        new_hint->perflock_handle = lock_handle;
+/* Releases the lock of a hint already removed from the table. */
+static void drop_hint_lock(const struct hint_data *hint, bool expired)
+{
+    lock_journal_remove(LOCK_JOURNAL_HINT, hint->hint_id);
+    hint_client_untrack(&active_hints, hint->hint_id);
+    hint_audit_released(hint->hint_id, hint->since_ns, expired);
+
+    POWER_TRACE_BEGIN(NULL, 0, "undo_hint_action hint=0x%lx handle=%lu",
+            hint->hint_id, hint->perflock_handle);
+    /* Release this lock. */
+    if (perf_arbiter_release(hint->perflock_handle) == -1)
+        ALOGE("Perflock release failed.");
+    POWER_TRACE_END();
+    POWER_TRACE_COUNTER(0, "boost:hint 0x%lx", hint->hint_id);
+}
 
-        if (add_list_node(&active_hint_list_head, new_hint) == NULL) {
-            free(new_hint);
-            /* Can't keep track of this lock. Release it. */
-            if (perf_lock_rel)
-                perf_lock_rel(lock_handle);
-            ALOGE("Failed to process hint.");
-            return -ENOMEM;
+/* Drops the lock held for 'hint_id'. Returns -ENOENT if none is. */
+static int release_hint_action(int hint_id)
+{
+    struct hint_data found_hint;
+    int ret;
+
+    pthread_mutex_lock(&active_hints_lock);
+    ret = hint_table_remove(&active_hints, hint_id, &found_hint);
+    pthread_mutex_unlock(&active_hints_lock);
+
+    if (ret == 0)
+        drop_hint_lock(&found_hint, false);
+
+    return ret;
+}
+
+void undo_hint_action(int hint_id)
+{
+    if (perf_lock_rel) {
+        if (release_hint_action(hint_id))
+            ALOGE("Invalid hint ID.");
+    }
+}
+
+/*
+ * Releases the lock for 'hint_id' if it was last requested at
+ * 'since_ns', i.e. nobody renewed it after it ran over its budget.
+ */
+void expire_hint_action(int hint_id, long long since_ns)
+{
+    struct hint_data *found, expired;
+    int ret = -ENOENT;
+
+    pthread_mutex_lock(&active_hints_lock);
+    found = hint_table_find(&active_hints, hint_id);
+    if (found && found->since_ns == since_ns)
+        ret = hint_table_remove(&active_hints, hint_id, &expired);
+    pthread_mutex_unlock(&active_hints_lock);
+
+    if (ret == 0)
+        drop_hint_lock(&expired, true);
+}
+
+/*
+ * Replaces the lock held for 'old_hint_id' (if any) with one for
+ * 'new_hint_id'. The new lock is taken before the old one is dropped,
+ * so there is no window without either; if the old lock already holds
+ * the same resources it is simply tracked under the new id. On failure
+ * the old lock is kept.
+ */
+int transition_hint_action(int old_hint_id, int new_hint_id,
+        int resource_values[], int num_resources)
+{
+    if (perf_lock_acq && perf_lock_rel) {
+        struct hint_client_holder holder = hint_holder(new_hint_id);
+        struct hint_data moved;
+        long long old_since_ns;
+        int ret;
+
+        pthread_mutex_lock(&active_hints_lock);
+        if (old_hint_id != new_hint_id &&
+                !hint_table_find(&active_hints, new_hint_id) &&
+                hint_holds(hint_table_find(&active_hints, old_hint_id),
+                        resource_values, num_resources)) {
+            /* Removing first frees the slot, so this insert can't fail. */
+            hint_table_remove(&active_hints, old_hint_id, &moved);
+            old_since_ns = moved.since_ns;
+            moved.hint_id = new_hint_id;
+            moved.since_ns = power_clock_now_ns();
+            moved.holder = holder;
+            hint_table_insert(&active_hints, &moved, NULL);
+            pthread_mutex_unlock(&active_hints_lock);
+
+            hint_client_untrack(&active_hints, old_hint_id);
+            track_hint(new_hint_id, holder);
+            hint_audit_released(old_hint_id, old_since_ns, false);
+            hint_audit_acquired(new_hint_id, moved.since_ns);
+            lock_journal_remove(LOCK_JOURNAL_HINT, old_hint_id);
+            lock_journal_add(LOCK_JOURNAL_HINT, new_hint_id, resource_values,
+                    num_resources);
+
+            POWER_TRACE_COUNTER(0, "boost:hint 0x%x", old_hint_id);
+            POWER_TRACE_COUNTER(moved.perflock_handle, "boost:hint 0x%x",
+                    new_hint_id);
+            return 0;
         }
+        pthread_mutex_unlock(&active_hints_lock);
+
+        ret = perform_hint_action(new_hint_id, resource_values, num_resources);
+        if (ret)
+            return ret;
+
+        if (old_hint_id != new_hint_id)
+            release_hint_action(old_hint_id);
     }
     return 0;
 }
 
-void undo_hint_action(int hint_id)
+/*
+ * Picks up after a previous instance of the HAL that died holding
+ * locks. Display state hints whose owner is still running are taken
+ * again first, so the device is not left unboosted in between; then
+ * every indefinite perfd lock the old instance held is released.
+ * Anything else is left for its client to ask for again.
+ */
+void recover_hint_locks(void)
 {
-    if (qcopt_handle) {
-        if (perf_lock_rel) {
-            /* Get hint-data associated with this hint-id */
-            struct list_node *found_node;
-            struct hint_data temp_hint_data = {
-                .hint_id = hint_id
-            };
-
-            found_node = find_node(&active_hint_list_head,
-                    &temp_hint_data);
-
-            if (found_node) {
-                /* Release this lock. */
-                struct hint_data *found_hint_data =
-                    (struct hint_data *)(found_node->data);
-
-                if (found_hint_data) {
-                    if (perf_lock_rel(found_hint_data->perflock_handle) == -1)
-                        ALOGE("Perflock release failed.");
-                }
-
-                if (found_node->data) {
-                    /* We can free the hint-data for this node. */
-                    free(found_node->data);
-                }
-
-                remove_list_node(&active_hint_list_head, found_node);
-            } else {
-                ALOGE("Invalid hint ID.");
-            }
+    static struct lock_journal_entry recovered[LOCK_JOURNAL_ENTRIES];
+    int count = lock_journal_init(recovered, LOCK_JOURNAL_ENTRIES);
+
+    replay_hint_locks(recovered, count);
+}
+
+/* The replay half of recover_hint_locks(), for entries already read back. */
+void replay_hint_locks(const struct lock_journal_entry *recovered, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        const struct lock_journal_entry *entry = &recovered[i];
+        struct hint_client owner = { entry->owner_pid, entry->owner_uid };
+
+        if (entry->kind != LOCK_JOURNAL_HINT)
+            continue;
+
+        if (!hint_persists(entry->id) || entry->num_resources < 1 ||
+                !owner.pid ||
+                hint_client_start_time(owner.pid) != entry->owner_start) {
+            ALOGI("Not restoring hint 0x%x", entry->id);
+            continue;
         }
+
+        ALOGI("Restoring hint 0x%x for pid %d", entry->id, owner.pid);
+        hint_client_enter(owner);
+        perform_hint_action(entry->id, (int *)entry->resources,
+                entry->num_resources);
+        hint_client_leave();
+    }
+
+    for (i = 0; i < count; i++) {
+        const struct lock_journal_entry *entry = &recovered[i];
+
+        if (entry->kind != LOCK_JOURNAL_PERFD || !perf_lock_rel)
+            continue;
+
+        /* Straight to perfd: the arbiter and batcher never saw these. */
+        ALOGI("Releasing orphaned perf lock %u", entry->id);
+        perf_lock_rel(entry->id);
+    }
+}
+
+/*
+ * Copies the currently held hint locks into 'hints', returning how many
+ * were copied. Intended for debugging.
+ */
+unsigned int get_active_hints(struct hint_data *hints, unsigned int max_hints)
+{
+    unsigned int count;
+
+    pthread_mutex_lock(&active_hints_lock);
+    count = hint_table_copy(&active_hints, hints, max_hints);
+    pthread_mutex_unlock(&active_hints_lock);
+
+    return count;
+}
+
+void dump_active_hints(void)
+{
+    struct hint_data hints[HINT_TABLE_SIZE];
+    unsigned int count = get_active_hints(hints, HINT_TABLE_SIZE);
+    unsigned int i;
+
+    ALOGI("%u active hint(s)", count);
+    for (i = 0; i < count; i++) {
+        ALOGI("  hint_id: 0x%lx handle: %lu", hints[i].hint_id,
+                hints[i].perflock_handle);
     }
 }
 
@@ -363,19 +977,11 @@ void undo_initial_hint_action()
 {
     if (qcopt_handle) {
         if (perf_lock_rel) {
-            perf_lock_rel(1);
+            timed_perf_lock_rel(1);
         }
     }
 }
 
-long long calc_timespan_us(struct timespec start, struct timespec end)
-{
-    long long diff_in_us = 0;
-    diff_in_us += (end.tv_sec - start.tv_sec) * USINSEC;
-    diff_in_us += (end.tv_nsec - start.tv_nsec) / NSINUS;
-    return diff_in_us;
-}
-
 int get_soc_id(void)
 {
     int fd;
@@ -29,6 +29,9 @@
 
 #include <cutils/properties.h>
 
+struct hint_data;
+struct lock_journal_entry;
+
 int sysfs_read(const char *path, char *s, int num_bytes);
 int sysfs_write(const char *path, char *s);
 int get_scaling_governor(char governor[], int size);
@@ -38,10 +41,18 @@ int is_ondemand_governor(char*);
 
 int perform_hint_action(int hint_id, int resource_values[], int num_resources);
 void undo_hint_action(int hint_id);
+void expire_hint_action(int hint_id, long long since_ns);
+int transition_hint_action(int old_hint_id, int new_hint_id,
+        int resource_values[], int num_resources);
 void undo_initial_hint_action();
+void recover_hint_locks(void);
+void replay_hint_locks(const struct lock_journal_entry *recovered, int count);
+unsigned int get_active_hints(struct hint_data *hints, unsigned int max_hints);
+void dump_active_hints(void);
 void release_request(int lock_handle);
 void interaction(int duration, int num_args, int opt_list[]);
+int interaction_with_handle(int lock_handle, int duration, int num_args, int opt_list[]);
 int perf_hint_enable(int hint_id, int duration);
+int perf_hint_enable_with_type(int hint_id, int duration, int type);
 
-long long calc_timespan_us(struct timespec start, struct timespec end);
 int get_soc_id(void);